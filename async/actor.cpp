@@ -0,0 +1,164 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <async/actor.h>
+
+#include <boost/bind.hpp>
+
+namespace async {
+
+namespace {
+
+// The mailbox being drained on the current thread.
+thread_local const Mailbox* current_mailbox = NULL;
+
+} // namespace
+
+MailboxQueue::MailboxQueue() 
+            : head_(&stub_)
+            , tail_(&stub_) {
+
+}
+MailboxQueue::~MailboxQueue() {
+    Node* node = NULL;
+    while ((node = Pop()) != NULL) {
+        delete node;
+    }
+}
+
+void MailboxQueue::Push(Node* node) {
+    node->next.store(NULL, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    // Between the exchange and this store the queue is cut in two,
+    // Pop sees the tail end only.
+    prev->next.store(node, std::memory_order_release);
+
+    return;
+}
+
+MailboxQueue::Node* MailboxQueue::Pop() {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (tail == &stub_) {
+        if (next == NULL) {
+            return NULL;
+        }
+        tail_ = next;
+        tail = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next != NULL) {
+        tail_ = next;
+        return tail;
+    }
+
+    // The tail is the last linked node, 
+    // unless a producer has not linked its node yet.
+    if (tail != head_.load(std::memory_order_acquire)) {
+        return NULL;
+    }
+
+    // Put the stub behind the last node so it can be taken out.
+    Push(&stub_);
+    next = tail->next.load(std::memory_order_acquire);
+    if (next != NULL) {
+        tail_ = next;
+        return tail;
+    }
+
+    return NULL;
+}
+
+Mailbox::Mailbox(Thread* thread, Thread::Priority priority) 
+       : thread_(thread)
+       , priority_(priority)
+       , pending_num_(0) {
+
+}
+
+void Mailbox::Post(Task&& task) {
+    MailboxQueue::Node* node = new MailboxQueue::Node();
+    node->task = std::move(task);
+    queue_.Push(node);
+
+    // Only the producer that wakes the mailbox posts it.
+    if (pending_num_.fetch_add(1) == 0) {
+        Schedule();
+    }
+
+    return;
+}
+
+bool Mailbox::IsCurrent() const {
+    return current_mailbox == this;
+}
+
+void Mailbox::Drain() {
+    const Mailbox* prev_mailbox = current_mailbox;
+    current_mailbox = this;
+
+    int run_num = 0;
+    for (; run_num < kBatchSize; run_num++) {
+        MailboxQueue::Node* node = queue_.Pop();
+        if (node == NULL) {
+            break;
+        }
+        node->task();
+        delete node;
+    }
+
+    current_mailbox = prev_mailbox;
+
+    // Messages left, or a full batch, go to the back of the pool 
+    // queue, other work gets a turn first.
+    if (pending_num_.fetch_sub(run_num) != size_t(run_num)) {
+        Schedule();
+    }
+
+    return;
+}
+
+void Mailbox::Schedule() {
+    // A drain lost to a full pool would leave pending_num_ above zero,
+    // no later Post would schedule the mailbox again.
+    thread_->PostTaskOverCapacity(boost::bind(&Mailbox::Drain, shared_from_this()), priority_);
+
+    return;
+}
+
+Actor::Actor(const std::shared_ptr<Thread>& thread, Thread::Priority priority) 
+     : thread_(thread)
+     , mailbox_(new Mailbox(thread.get(), priority)) {
+
+}
+Actor::~Actor() {
+
+}
+
+void Actor::Post(Task&& task) {
+    mailbox_->Post(std::move(task));
+
+    return;
+}
+
+bool Actor::IsCurrent() const {
+    return mailbox_->IsCurrent();
+}
+
+} // namespace async
@@ -0,0 +1,110 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <async/task.h>
+#include <async/thread.h>
+
+namespace async {
+
+// Lock-free multi-producer single-consumer message queue.
+// Any thread may Push, only the actor being drained Pops.
+class MailboxQueue {
+public:
+    struct Node {
+        Node() : next(NULL) {}
+
+        std::atomic<Node*> next;
+        Task task;
+    };
+
+    MailboxQueue();
+    // Deletes the messages never popped.
+    ~MailboxQueue();
+
+    void Push(Node* node);
+    // Returns NULL when empty, or while a producer is halfway 
+    // through its Push. The caller owns the returned node.
+    Node* Pop();
+
+private:
+    MailboxQueue(const MailboxQueue&) = delete;
+    MailboxQueue& operator=(const MailboxQueue&) = delete;
+
+    // Producers swap themselves in at the head.
+    std::atomic<Node*> head_;
+    // Only the consumer touches the tail.
+    Node* tail_;
+    Node stub_;
+};
+
+// Mailbox of one actor, shared with its scheduled drain task.
+class Mailbox : public std::enable_shared_from_this<Mailbox> {
+public:
+    Mailbox(Thread* thread, Thread::Priority priority);
+
+    void Post(Task&& task);
+    bool IsCurrent() const;
+
+private:
+    // Runs up to kBatchSize messages, then hands the worker back.
+    void Drain();
+    void Schedule();
+
+    static const int kBatchSize = 64;
+
+    Thread* thread_;
+    Thread::Priority priority_;
+    // Messages posted and not run yet, the producer that raises it 
+    // from zero posts the drain, a drain leaving it above zero reposts.
+    std::atomic<size_t> pending_num_;
+    MailboxQueue queue_;
+};
+
+// Actor class.
+// Messages posted to an actor run one at a time and in order on a 
+// shared pool, so the state owned by the actor needs no lock.
+// A mailbox is only put on the pool when it gets its first message, 
+// then drained in batches, so thousands of actors can share a few 
+// threads without a post per message.
+class Actor {
+public:
+    explicit Actor(const std::shared_ptr<Thread>& thread, 
+                   Thread::Priority priority = Thread::NORMAL);
+    // Messages already posted still run.
+    ~Actor();
+
+    // Post a message, callable from any thread.
+    // A bounded pool never drops it, the drain goes over its capacity.
+    void Post(Task&& task);
+
+    // True while a message of this actor runs on the calling thread.
+    bool IsCurrent() const;
+
+private:
+    Actor(const Actor&) = delete;
+    Actor& operator=(const Actor&) = delete;
+
+    std::shared_ptr<Thread> thread_;
+    std::shared_ptr<Mailbox> mailbox_;
+};
+
+}; // namespace async
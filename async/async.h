@@ -18,8 +18,13 @@
 
 #pragma once
 
+#include <async/cancellation.h>
 #include <async/timer.h>
 #include <async/thread.h>
+#include <async/future.h>
+#include <async/parallel.h>
+#include <async/actor.h>
+#include <async/file.h>
 
 // Get the current thread id
 #define CURRENT_THREAD boost::this_thread::get_id()
\ No newline at end of file
@@ -0,0 +1,104 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <async/task.h>
+
+namespace async {
+
+// Cancellation token class.
+// Copies share one flag, work posted with a token is dropped
+// before it runs once any copy is cancelled. Cancel does not stop
+// work that has already started, the work may poll IsCancelled.
+class CancellationToken {
+public:
+    CancellationToken() : state_(std::make_shared<State>()) {}
+
+    // Runs the registered callbacks once, on the calling thread.
+    void Cancel() {
+        if (state_->cancelled.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+
+        std::vector<std::pair<int, Task>> callback_list;
+        state_->mutex.lock();
+        callback_list.swap(state_->callback_list);
+        state_->mutex.unlock();
+
+        // Out of the lock, a callback may register or unregister.
+        for (size_t i = 0; i < callback_list.size(); i++) {
+            callback_list[i].second();
+        }
+
+        return;
+    }
+    bool IsCancelled() const {
+        return state_->cancelled.load(std::memory_order_acquire);
+    }
+
+    // Run callback when the token is cancelled, at once if it already is.
+    // Returns the id to unregister it, 0 if it already ran.
+    int Register(Task&& callback) {
+        state_->mutex.lock();
+        if (IsCancelled()) {
+            state_->mutex.unlock();
+            callback();
+            return 0;
+        }
+        int id = state_->next_id++;
+        state_->callback_list.push_back(std::make_pair(id, std::move(callback)));
+        state_->mutex.unlock();
+
+        return id;
+    }
+    // Release a callback that is no longer needed. 
+    // One Cancel has already taken may still run.
+    void Unregister(int id) {
+        boost::mutex::scoped_lock lock(state_->mutex);
+        std::vector<std::pair<int, Task>>& callback_list = state_->callback_list;
+        for (size_t i = 0; i < callback_list.size(); i++) {
+            if (callback_list[i].first == id) {
+                callback_list.erase(callback_list.begin() + i);
+                break;
+            }
+        }
+
+        return;
+    }
+
+private:
+    struct State {
+        State() : cancelled(false), next_id(1) {}
+
+        std::atomic<bool> cancelled;
+        // Guards the members below.
+        boost::mutex mutex;
+        int next_id;
+        std::vector<std::pair<int, Task>> callback_list;
+    };
+
+    std::shared_ptr<State> state_;
+};
+
+}; // namespace async
@@ -0,0 +1,339 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine)
+#error "async/coroutine.h needs C++20, configure with -DASYNC_COROUTINE=ON"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <async/thread.h>
+#include <async/timer.h>
+#include <async/future.h>
+
+namespace async {
+
+// Recycles coroutine frames of the current thread by size class,
+// so creating a coroutine in steady state does not allocate.
+class FramePool {
+public:
+    static void* Allocate(size_t size) {
+        size_t index = (size + kClassSize - 1) / kClassSize;
+        if (index >= kClassNum) {
+            return ::operator new(size);
+        }
+
+        FreeList& free_list = free_list_table()[index];
+        if (free_list.head == NULL) {
+            return ::operator new(index * kClassSize);
+        }
+
+        Frame* frame = free_list.head;
+        free_list.head = frame->next;
+        free_list.size--;
+
+        return frame;
+    }
+
+    static void Free(void* ptr, size_t size) {
+        size_t index = (size + kClassSize - 1) / kClassSize;
+        if (index >= kClassNum) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        FreeList& free_list = free_list_table()[index];
+        if (free_list.size >= kMaxFreeNum) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        Frame* frame = static_cast<Frame*>(ptr);
+        frame->next = free_list.head;
+        free_list.head = frame;
+        free_list.size++;
+    }
+
+private:
+    static const size_t kClassSize = 64;
+    static const size_t kClassNum = 64;
+    static const size_t kMaxFreeNum = 1024;
+
+    struct Frame {
+        Frame* next;
+    };
+
+    struct FreeList {
+        Frame* head = NULL;
+        size_t size = 0;
+
+        ~FreeList() {
+            while (head != NULL) {
+                Frame* frame = head;
+                head = frame->next;
+                ::operator delete(frame);
+            }
+        }
+    };
+
+    static FreeList* free_list_table() {
+        static thread_local FreeList free_list_table[kClassNum];
+        return free_list_table;
+    }
+};
+
+// Resumes the awaiting coroutine as a task of thread.
+// Resumes go over the capacity of a bounded pool, a dropped one 
+// would leave the coroutine suspended for good.
+class ScheduleAwaiter {
+public:
+    ScheduleAwaiter(Thread* thread, Thread::Priority priority) 
+        : thread_(thread)
+        , priority_(priority) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        thread_->PostTaskOverCapacity([handle]() { handle.resume(); }, priority_);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    Thread* thread_;
+    Thread::Priority priority_;
+};
+
+inline ScheduleAwaiter Thread::Schedule(Priority priority) {
+    return ScheduleAwaiter(this, priority);
+}
+
+// Resumes the awaiting coroutine after duration, 
+// on the pool it was suspended on.
+class SleepAwaiter {
+public:
+    SleepAwaiter(Timer* timer, const boost::posix_time::time_duration& duration)
+        : timer_(timer)
+        , duration_(duration) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        Thread* thread = Thread::Current();
+        timer_->CreateInlineTimerTask([thread, handle]() {
+            if (thread != NULL) {
+                thread->PostTaskOverCapacity([handle]() { handle.resume(); });
+            } else {
+                handle.resume();
+            }
+        }, duration_);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    Timer* timer_;
+    boost::posix_time::time_duration duration_;
+};
+
+inline SleepAwaiter Timer::Sleep(const boost::posix_time::time_duration& duration) {
+    return SleepAwaiter(this, duration);
+}
+
+template <typename T>
+class CoTask;
+
+// Parts of a promise shared by CoTask<T> and CoTask<void>.
+class CoPromiseBase {
+public:
+    // Resume the awaiting coroutine when done, on the pool it awaited
+    // from. Inline when already there, otherwise posted back to it.
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            std::coroutine_handle<> continuation = handle.promise().continuation_;
+            Thread* thread = handle.promise().continuation_thread_;
+            if (!continuation) {
+                return std::noop_coroutine();
+            }
+            if (thread == NULL || thread == Thread::Current()) {
+                return continuation;
+            }
+            // The awaiting coroutine may free this frame as soon as it runs.
+            thread->PostTaskOverCapacity([continuation]() { continuation.resume(); });
+            return std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    static void* operator new(size_t size) {
+        return FramePool::Allocate(size);
+    }
+    static void operator delete(void* ptr, size_t size) {
+        FramePool::Free(ptr, size);
+    }
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() {
+        exception_ = std::current_exception();
+    }
+
+    void set_continuation(std::coroutine_handle<> continuation, Thread* thread) {
+        continuation_ = continuation;
+        continuation_thread_ = thread;
+    }
+
+protected:
+    void Rethrow() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+private:
+    std::coroutine_handle<> continuation_;
+    // Pool of the awaiting coroutine, NULL off any pool.
+    Thread* continuation_thread_ = NULL;
+    std::exception_ptr exception_;
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase {
+public:
+    CoTask<T> get_return_object();
+
+    void return_value(T value) {
+        value_ = std::move(value);
+    }
+
+    T result() {
+        Rethrow();
+        return std::move(*value_);
+    }
+
+private:
+    boost::optional<T> value_;
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase {
+public:
+    CoTask<void> get_return_object();
+
+    void return_void() {}
+
+    void result() {
+        Rethrow();
+    }
+};
+
+// Lazily started coroutine returning T.
+// co_await a CoTask starts it and resumes the awaiting coroutine 
+// when it returns, back on the pool it awaited from.
+template <typename T>
+class CoTask {
+public:
+    typedef CoPromise<T> promise_type;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    CoTask(CoTask&& other) noexcept : handle_(other.handle_) {
+        other.handle_ = NULL;
+    }
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = other.handle_;
+            other.handle_ = NULL;
+        }
+        return *this;
+    }
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept {
+        handle_.promise().set_continuation(continuation, Thread::Current());
+        return handle_;
+    }
+    T await_resume() {
+        return handle_.promise().result();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+CoTask<T> CoPromise<T>::get_return_object() {
+    return CoTask<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+inline CoTask<void> CoPromise<void>::get_return_object() {
+    return CoTask<void>(std::coroutine_handle<CoPromise<void>>::from_promise(*this));
+}
+
+// Coroutine that owns itself, its frame is freed when it returns.
+struct DetachedCoroutine {
+    struct promise_type {
+        static void* operator new(size_t size) {
+            return FramePool::Allocate(size);
+        }
+        static void operator delete(void* ptr, size_t size) {
+            FramePool::Free(ptr, size);
+        }
+
+        DetachedCoroutine get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template <typename T>
+DetachedCoroutine SpawnCoroutine(Thread* thread, CoTask<T> task, Promise<T> promise) {
+    co_await thread->Schedule();
+    if constexpr (std::is_void<T>::value) {
+        co_await task;
+        promise.SetValue();
+    } else {
+        promise.SetValue(co_await task);
+    }
+}
+
+// Start a coroutine on thread.
+// Returns the future of its return value.
+template <typename T>
+Future<T> Spawn(Thread* thread, CoTask<T> task) {
+    Promise<T> promise;
+    Future<T> future = promise.GetFuture();
+    SpawnCoroutine(thread, std::move(task), promise);
+
+    return future;
+}
+
+}; // namespace async
@@ -0,0 +1,225 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <async/file.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <boost/bind.hpp>
+
+namespace async {
+
+File::File(const std::shared_ptr<Thread>& thread) 
+    : thread_(thread)
+#ifdef ASYNC_FILE_IO_URING
+    , use_io_uring_(Thread::IoUringSupported())
+#else
+    , use_io_uring_(false)
+#endif
+{
+
+}
+File::~File() {
+    Close();
+}
+
+bool File::Open(const std::string& path, bool write) {
+    Close();
+
+#ifdef ASYNC_FILE_IO_URING
+    if (use_io_uring_) {
+        boost::system::error_code err;
+        file_.reset(new boost::asio::random_access_file(thread_->io_service()));
+        file_->open(path, write ? boost::asio::file_base::read_write | boost::asio::file_base::create : 
+                                  boost::asio::file_base::read_only, err);
+        if (err) {
+            file_.reset();
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    int fd = open(path.c_str(), write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    fd_.reset(new int(fd), &File::CloseFd);
+
+    return true;
+}
+
+void File::Close() {
+#ifdef ASYNC_FILE_IO_URING
+    registration_.reset();
+    file_.reset();
+#endif
+
+    fd_.reset();
+
+    return;
+}
+
+void File::ReadAt(uint64_t offset, void* buffer, size_t size, const CALLBACK& callback) {
+#ifdef ASYNC_FILE_IO_URING
+    if (use_io_uring_) {
+        if (!file_) {
+            PostError(boost::asio::error::bad_descriptor, callback);
+            return;
+        }
+        boost::asio::async_read_at(*file_, offset, boost::asio::buffer(buffer, size), callback);
+        return;
+    }
+#endif
+
+    if (!fd_) {
+        PostError(boost::asio::error::bad_descriptor, callback);
+        return;
+    }
+    thread_->PostTaskOverCapacity(boost::bind(&File::ReadInPool, fd_, offset, buffer, size, 
+                                              callback));
+
+    return;
+}
+
+void File::WriteAt(uint64_t offset, const void* buffer, size_t size, const CALLBACK& callback) {
+#ifdef ASYNC_FILE_IO_URING
+    if (use_io_uring_) {
+        if (!file_) {
+            PostError(boost::asio::error::bad_descriptor, callback);
+            return;
+        }
+        boost::asio::async_write_at(*file_, offset, boost::asio::buffer(buffer, size), callback);
+        return;
+    }
+#endif
+
+    if (!fd_) {
+        PostError(boost::asio::error::bad_descriptor, callback);
+        return;
+    }
+    thread_->PostTaskOverCapacity(boost::bind(&File::WriteInPool, fd_, offset, buffer, size, 
+                                              callback));
+
+    return;
+}
+
+void File::RegisterBuffers(const std::vector<boost::asio::mutable_buffer>& buffer_list) {
+    buffer_list_ = buffer_list;
+
+#ifdef ASYNC_FILE_IO_URING
+    if (use_io_uring_) {
+        registration_.reset(new REGISTRATION(
+            boost::asio::register_buffers(thread_->io_service(), buffer_list_)));
+    }
+#endif
+
+    return;
+}
+
+void File::ReadRegisteredAt(uint64_t offset, size_t buffer_index, const CALLBACK& callback) {
+    if (buffer_index >= buffer_list_.size()) {
+        PostError(boost::asio::error::invalid_argument, callback);
+        return;
+    }
+
+#ifdef ASYNC_FILE_IO_URING
+    if (use_io_uring_) {
+        if (!file_) {
+            PostError(boost::asio::error::bad_descriptor, callback);
+            return;
+        }
+        if (!registration_) {
+            PostError(boost::asio::error::invalid_argument, callback);
+            return;
+        }
+        file_->async_read_some_at(offset, (*registration_)[buffer_index], callback);
+        return;
+    }
+#endif
+
+    const boost::asio::mutable_buffer& buffer = buffer_list_[buffer_index];
+    ReadAt(offset, buffer.data(), buffer.size(), callback);
+
+    return;
+}
+
+bool File::uses_io_uring() const {
+    return use_io_uring_;
+}
+
+void File::CloseFd(int* fd) {
+    close(*fd);
+    delete fd;
+
+    return;
+}
+
+void File::PostError(const boost::system::error_code& err, const CALLBACK& callback) {
+    thread_->PostTaskOverCapacity(boost::bind(callback, err, 0));
+
+    return;
+}
+
+void File::ReadInPool(const std::shared_ptr<int>& fd, uint64_t offset, void* buffer, 
+                      size_t size, const CALLBACK& callback) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = pread(*fd, static_cast<char*>(buffer) + done, size - done, offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            callback(boost::system::error_code(errno, boost::system::system_category()), done);
+            return;
+        }
+        if (result == 0) {
+            callback(boost::asio::error::eof, done);
+            return;
+        }
+        done += result;
+    }
+
+    callback(boost::system::error_code(), done);
+
+    return;
+}
+
+void File::WriteInPool(const std::shared_ptr<int>& fd, uint64_t offset, const void* buffer, 
+                       size_t size, const CALLBACK& callback) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = pwrite(*fd, static_cast<const char*>(buffer) + done, size - done, 
+                                offset + done);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0) {
+            callback(boost::system::error_code(errno, boost::system::system_category()), done);
+            return;
+        }
+        done += result;
+    }
+
+    callback(boost::system::error_code(), done);
+
+    return;
+}
+
+} // namespace async
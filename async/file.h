@@ -0,0 +1,95 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <boost/asio.hpp>
+#include <boost/function.hpp>
+#include <async/thread.h>
+
+// asio runs file operations on io_uring when built with it.
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_HAS_FILE)
+#define ASYNC_FILE_IO_URING
+#endif
+
+namespace async {
+
+// Random access file with asynchronous reads and writes.
+// With io_uring the operations go to the ring of the pool's io_service,
+// which submits and reaps them in batches. Without io_uring, or on a 
+// kernel without it, they run as pread and pwrite tasks on the pool.
+// Callbacks run on the pool either way, a bounded pool never drops them.
+class File {
+public:
+    // Error and the number of bytes transferred.
+    // A read reaching the end of the file completes with 
+    // boost::asio::error::eof and the bytes it read.
+    typedef boost::function<void(const boost::system::error_code&, size_t)> CALLBACK;
+
+    explicit File(const std::shared_ptr<Thread>& thread);
+    ~File();
+
+    // Returns false if the file can not be opened.
+    // A file opened for write is created if missing.
+    bool Open(const std::string& path, bool write);
+    // Reads and writes already queued on the pool still complete,
+    // the descriptor is closed once the last of them ran.
+    void Close();
+
+    // The buffer must stay valid until the callback runs.
+    void ReadAt(uint64_t offset, void* buffer, size_t size, const CALLBACK& callback);
+    void WriteAt(uint64_t offset, const void* buffer, size_t size, const CALLBACK& callback);
+
+    // Register buffers with the ring once, reads into them skip 
+    // mapping the pages on every operation. 
+    // Without io_uring the buffers are only remembered.
+    void RegisterBuffers(const std::vector<boost::asio::mutable_buffer>& buffer_list);
+    // Read at most the size of registered buffer buffer_index.
+    // Fails with invalid_argument if the buffer was not registered.
+    void ReadRegisteredAt(uint64_t offset, size_t buffer_index, const CALLBACK& callback);
+
+    bool uses_io_uring() const;
+
+private:
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    // Closes the descriptor when the last owner goes away.
+    static void CloseFd(int* fd);
+    static void ReadInPool(const std::shared_ptr<int>& fd, uint64_t offset, void* buffer, 
+                           size_t size, const CALLBACK& callback);
+    static void WriteInPool(const std::shared_ptr<int>& fd, uint64_t offset, const void* buffer, 
+                            size_t size, const CALLBACK& callback);
+    void PostError(const boost::system::error_code& err, const CALLBACK& callback);
+
+    std::shared_ptr<Thread> thread_;
+    bool use_io_uring_;
+    // Shared with the queued pread and pwrite tasks.
+    std::shared_ptr<int> fd_;
+    std::vector<boost::asio::mutable_buffer> buffer_list_;
+#ifdef ASYNC_FILE_IO_URING
+    typedef boost::asio::buffer_registration<std::vector<boost::asio::mutable_buffer>> REGISTRATION;
+    std::unique_ptr<boost::asio::random_access_file> file_;
+    std::unique_ptr<REGISTRATION> registration_;
+#endif
+};
+
+}; // namespace async
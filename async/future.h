@@ -0,0 +1,467 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <async/task.h>
+#include <async/thread.h>
+
+namespace async {
+
+// Value held by a Future<void>.
+struct Unit {};
+
+// Held by a future whose promises were all destroyed without a value,
+// like the promise of a task destroyed by a stopped pool.
+class BrokenPromise : public std::logic_error {
+public:
+    BrokenPromise() : std::logic_error("async: promise destroyed without a value") {}
+};
+
+template <typename T>
+struct FutureTraits {
+    typedef T value_type;
+};
+template <>
+struct FutureTraits<void> {
+    typedef Unit value_type;
+};
+
+// Call a continuation with the value, or with nothing for a Future<void>.
+template <typename F, typename V>
+auto FutureCall(F& function, const V& value) -> decltype(function(value)) {
+    return function(value);
+}
+template <typename F>
+auto FutureCall(F& function, const Unit&) -> decltype(function()) {
+    return function();
+}
+
+// Return type of a continuation of a Future<T>.
+template <typename F, typename T>
+struct FutureResult {
+    typedef decltype(FutureCall(std::declval<typename std::decay<F>::type&>(), 
+                                std::declval<const typename FutureTraits<T>::value_type&>())) type;
+};
+
+// State shared by a Promise and its Futures.
+// Continuations run inline on the thread that sets the value,
+// or on the calling thread when the value is already set.
+// The state is ready with a value or with an exception.
+template <typename T>
+class FutureState {
+public:
+    typedef typename FutureTraits<T>::value_type value_type;
+
+    FutureState() : ready_(false), promise_num_(0) {}
+
+    // Only the first value or exception is kept.
+    void SetValue(value_type&& value) {
+        mutex_.lock();
+        if (ready_) {
+            mutex_.unlock();
+            return;
+        }
+        value_ = std::move(value);
+        Finish();
+    }
+    void SetException(const std::exception_ptr& exception) {
+        mutex_.lock();
+        if (ready_) {
+            mutex_.unlock();
+            return;
+        }
+        exception_ = exception;
+        Finish();
+    }
+
+    // Count the promises, the last one to go breaks an unset state.
+    void AddPromise() {
+        promise_num_++;
+    }
+    void ReleasePromise() {
+        if (--promise_num_ == 0) {
+            SetException(std::make_exception_ptr(BrokenPromise()));
+        }
+    }
+
+    void OnReady(Task&& callback) {
+        mutex_.lock();
+        if (!ready_) {
+            // Most futures have one continuation, it is kept inline.
+            if (!callback_) {
+                callback_ = std::move(callback);
+            } else {
+                callback_list_.push_back(std::move(callback));
+            }
+            mutex_.unlock();
+            return;
+        }
+        mutex_.unlock();
+
+        callback();
+    }
+
+    bool ready() {
+        boost::mutex::scoped_lock lock(mutex_);
+        return ready_;
+    }
+
+    // Only valid once ready, value() only without an exception.
+    const value_type& value() const {
+        return *value_;
+    }
+    const std::exception_ptr& exception() const {
+        return exception_;
+    }
+
+private:
+    // Called with mutex_ held, releases it.
+    void Finish() {
+        ready_ = true;
+        Task callback = std::move(callback_);
+        std::vector<Task> callback_list;
+        callback_list.swap(callback_list_);
+        mutex_.unlock();
+
+        if (callback) {
+            callback();
+        }
+        for (size_t i = 0; i < callback_list.size(); i++) {
+            callback_list[i]();
+        }
+    }
+
+    boost::mutex mutex_;
+    bool ready_;
+    std::atomic<int> promise_num_;
+    boost::optional<value_type> value_;
+    std::exception_ptr exception_;
+    Task callback_;
+    std::vector<Task> callback_list_;
+};
+
+template <typename T>
+class Future;
+
+// Write side of a future.
+// Copies share the result, when the last one is destroyed without
+// setting it the future holds a BrokenPromise.
+template <typename T>
+class Promise {
+public:
+    typedef typename FutureTraits<T>::value_type value_type;
+
+    Promise() : state_(std::make_shared<FutureState<T>>()) {
+        state_->AddPromise();
+    }
+    Promise(const Promise& other) : state_(other.state_) {
+        if (state_) {
+            state_->AddPromise();
+        }
+    }
+    Promise(Promise&& other) : state_(std::move(other.state_)) {}
+    Promise& operator=(const Promise& other) {
+        if (this != &other) {
+            Release();
+            state_ = other.state_;
+            if (state_) {
+                state_->AddPromise();
+            }
+        }
+        return *this;
+    }
+    Promise& operator=(Promise&& other) {
+        if (this != &other) {
+            Release();
+            state_ = std::move(other.state_);
+        }
+        return *this;
+    }
+    ~Promise() {
+        Release();
+    }
+
+    Future<T> GetFuture() const {
+        return Future<T>(state_);
+    }
+
+    void SetValue(value_type value) {
+        state_->SetValue(std::move(value));
+    }
+    // For a Promise<void>.
+    void SetValue() {
+        state_->SetValue(value_type());
+    }
+    void SetException(const std::exception_ptr& exception) {
+        state_->SetException(exception);
+    }
+
+private:
+    void Release() {
+        if (state_) {
+            state_->ReleasePromise();
+            state_.reset();
+        }
+    }
+
+    std::shared_ptr<FutureState<T>> state_;
+};
+
+// Run a function and set its return value to a promise.
+template <typename R>
+struct FutureInvoker {
+    template <typename F, typename V>
+    static void Run(Promise<R>& promise, F& function, const V& value) {
+        promise.SetValue(FutureCall(function, value));
+    }
+};
+template <>
+struct FutureInvoker<void> {
+    template <typename F, typename V>
+    static void Run(Promise<void>& promise, F& function, const V& value) {
+        FutureCall(function, value);
+        promise.SetValue();
+    }
+};
+
+// Continuation of a Future<T> returning R.
+// An exception of the source is passed on, function is not called.
+template <typename F, typename T, typename R>
+struct FutureContinuation {
+    void operator()() {
+        if (source->exception()) {
+            promise.SetException(source->exception());
+            return;
+        }
+        FutureInvoker<R>::Run(promise, function, source->value());
+    }
+
+    F function;
+    std::shared_ptr<FutureState<T>> source;
+    Promise<R> promise;
+};
+
+// Posts the continuation to a thread instead of running it inline,
+// a bounded pool never drops it.
+template <typename F, typename T, typename R>
+struct PostedContinuation {
+    void operator()() {
+        thread->PostTaskOverCapacity(std::move(continuation), priority);
+    }
+
+    std::shared_ptr<Thread> thread;
+    Thread::Priority priority;
+    FutureContinuation<F, T, R> continuation;
+};
+
+// Read side of a result that is set later.
+// A future is a cheap handle, copies share the same result.
+template <typename T>
+class Future {
+public:
+    typedef typename FutureTraits<T>::value_type value_type;
+
+    Future() {}
+    explicit Future(const std::shared_ptr<FutureState<T>>& state) : state_(state) {}
+
+    bool valid() const {
+        return state_.get() != NULL;
+    }
+
+    bool IsReady() const {
+        return state_->ready();
+    }
+
+    // Blocking waits for the result, rethrows the exception it holds,
+    // BrokenPromise when it was never set.
+    // Never call it on the only worker of the thread that sets it.
+    const value_type& Get() const {
+        if (!state_->ready()) {
+            boost::mutex mutex;
+            boost::condition_variable condition;
+            bool ready = false;
+            state_->OnReady(Notify(&mutex, &condition, &ready));
+
+            boost::mutex::scoped_lock lock(mutex);
+            while (!ready) {
+                condition.wait(lock);
+            }
+        }
+
+        if (state_->exception()) {
+            std::rethrow_exception(state_->exception());
+        }
+        return state_->value();
+    }
+
+    // Run function with the result, inline on the thread that sets it.
+    // Returns the future of the function's return value.
+    template <typename F>
+    Future<typename FutureResult<F, T>::type> Then(F&& function) const {
+        typedef typename FutureResult<F, T>::type R;
+        FutureContinuation<typename std::decay<F>::type, T, R> continuation = {
+            std::forward<F>(function), state_, Promise<R>() };
+        Future<R> future = continuation.promise.GetFuture();
+        state_->OnReady(std::move(continuation));
+
+        return future;
+    }
+
+    // Run function with the result as a task of thread.
+    template <typename F>
+    Future<typename FutureResult<F, T>::type> Then(const std::shared_ptr<Thread>& thread, 
+                                                   F&& function,
+                                                   Thread::Priority priority = Thread::NORMAL) const {
+        typedef typename FutureResult<F, T>::type R;
+        PostedContinuation<typename std::decay<F>::type, T, R> continuation = {
+            thread, priority, { std::forward<F>(function), state_, Promise<R>() } };
+        Future<R> future = continuation.continuation.promise.GetFuture();
+        state_->OnReady(std::move(continuation));
+
+        return future;
+    }
+
+    const std::shared_ptr<FutureState<T>>& state() const {
+        return state_;
+    }
+
+private:
+    struct Notify {
+        Notify(boost::mutex* mutex, boost::condition_variable* condition, bool* ready)
+            : mutex_(mutex), condition_(condition), ready_(ready) {}
+
+        void operator()() {
+            boost::mutex::scoped_lock lock(*mutex_);
+            *ready_ = true;
+            condition_->notify_one();
+        }
+
+        boost::mutex* mutex_;
+        boost::condition_variable* condition_;
+        bool* ready_;
+    };
+
+    std::shared_ptr<FutureState<T>> state_;
+};
+
+// A future that is ready when all futures are ready,
+// its value holds their values in order, or the first exception.
+template <typename T>
+Future<std::vector<typename FutureTraits<T>::value_type>> WhenAll(const std::vector<Future<T>>& future_list) {
+    typedef typename FutureTraits<T>::value_type V;
+
+    struct Context {
+        std::atomic<size_t> remain_num;
+        std::vector<Future<T>> future_list;
+        Promise<std::vector<V>> promise;
+    };
+    struct Callback {
+        void operator()() {
+            if (--context->remain_num > 0) {
+                return;
+            }
+
+            std::vector<V> value_list;
+            value_list.reserve(context->future_list.size());
+            for (size_t i = 0; i < context->future_list.size(); i++) {
+                if (context->future_list[i].state()->exception()) {
+                    context->promise.SetException(context->future_list[i].state()->exception());
+                    return;
+                }
+                value_list.push_back(context->future_list[i].state()->value());
+            }
+            context->promise.SetValue(std::move(value_list));
+        }
+
+        std::shared_ptr<Context> context;
+    };
+
+    std::shared_ptr<Context> context = std::make_shared<Context>();
+    context->remain_num = future_list.size();
+    context->future_list = future_list;
+    Future<std::vector<V>> future = context->promise.GetFuture();
+    if (future_list.empty()) {
+        context->promise.SetValue(std::vector<V>());
+        return future;
+    }
+
+    for (size_t i = 0; i < future_list.size(); i++) {
+        Callback callback = { context };
+        future_list[i].state()->OnReady(std::move(callback));
+    }
+
+    return future;
+}
+
+// A future that is ready when any future is ready,
+// its value is the index of the first ready future.
+template <typename T>
+Future<size_t> WhenAny(const std::vector<Future<T>>& future_list) {
+    struct Callback {
+        void operator()() {
+            promise.SetValue(index);
+        }
+
+        size_t index;
+        Promise<size_t> promise;
+    };
+
+    Promise<size_t> promise;
+    for (size_t i = 0; i < future_list.size(); i++) {
+        Callback callback = { i, promise };
+        future_list[i].state()->OnReady(std::move(callback));
+    }
+
+    return promise.GetFuture();
+}
+
+// Task that sets the return value of function to promise.
+template <typename F, typename R>
+struct PromiseTask {
+    void operator()() {
+        FutureInvoker<R>::Run(promise, function, Unit());
+    }
+
+    F function;
+    Promise<R> promise;
+};
+
+template <typename F>
+Future<decltype(std::declval<F&>()())> Thread::PostTaskWithResult(F&& function, 
+                                                                  Priority priority) {
+    typedef decltype(std::declval<F&>()()) R;
+    PromiseTask<typename std::decay<F>::type, R> task = { std::forward<F>(function), Promise<R>() };
+    Future<R> future = task.promise.GetFuture();
+    // Never dropped, the caller may be blocked on the future.
+    PostTaskOverCapacity(std::move(task), priority);
+
+    return future;
+}
+
+}; // namespace async
@@ -0,0 +1,135 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <async/parallel.h>
+
+#include <atomic>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace async {
+
+namespace {
+
+// State shared by the participants of one ParallelRun.
+// Helpers that start after the range is done only touch this,
+// the body is only called for chunks taken before that.
+struct ParallelContext {
+    ParallelContext(size_t begin, size_t end, size_t grain, size_t participant_num,
+                    const boost::function<void(size_t, size_t, size_t)>* body)
+        : next(begin)
+        , end(end)
+        , grain(grain)
+        , participant_num(participant_num)
+        , next_participant(1)
+        , done_num(0)
+        , total_num(end - begin)
+        , finished(false)
+        , body(body) {}
+
+    // Take the next chunk, about 1/2 of an even share of what is left.
+    bool TakeChunk(size_t& chunk_begin, size_t& chunk_end) {
+        size_t current = next;
+        while (current < end) {
+            size_t remain = end - current;
+            size_t chunk = std::max(grain, remain / (2 * participant_num));
+            chunk = std::min(chunk, remain);
+            if (next.compare_exchange_weak(current, current + chunk)) {
+                chunk_begin = current;
+                chunk_end = current + chunk;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Run(size_t participant) {
+        size_t chunk_begin = 0;
+        size_t chunk_end = 0;
+        while (TakeChunk(chunk_begin, chunk_end)) {
+            (*body)(participant, chunk_begin, chunk_end);
+
+            if (done_num.fetch_add(chunk_end - chunk_begin) + (chunk_end - chunk_begin) == total_num) {
+                boost::mutex::scoped_lock lock(mutex);
+                finished = true;
+                condition.notify_one();
+            }
+        }
+    }
+
+    std::atomic<size_t> next;
+    size_t end;
+    size_t grain;
+    size_t participant_num;
+    std::atomic<size_t> next_participant;
+    std::atomic<size_t> done_num;
+    size_t total_num;
+
+    boost::mutex mutex;
+    boost::condition_variable condition;
+    bool finished;
+
+    const boost::function<void(size_t, size_t, size_t)>* body;
+};
+
+void ParallelHelper(const std::shared_ptr<ParallelContext>& context) {
+    context->Run(context->next_participant++);
+}
+
+} // namespace
+
+void ParallelRun(Thread& thread, 
+                 size_t begin, 
+                 size_t end, 
+                 size_t grain,
+                 size_t participant_num,
+                 const boost::function<void(size_t, size_t, size_t)>& body) {
+    if (begin >= end) {
+        return;
+    }
+
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    size_t helper_num = participant_num > 0 ? participant_num - 1 : 0;
+    helper_num = std::min<size_t>(helper_num, (end - begin - 1) / grain);
+    if (helper_num == 0) {
+        body(0, begin, end);
+        return;
+    }
+
+    std::shared_ptr<ParallelContext> context = std::make_shared<ParallelContext>(
+        begin, end, grain, helper_num + 1, &body);
+    for (size_t i = 0; i < helper_num; i++) {
+        thread.PostTask(boost::bind(&ParallelHelper, context));
+    }
+
+    context->Run(0);
+
+    boost::mutex::scoped_lock lock(context->mutex);
+    while (!context->finished) {
+        context->condition.wait(lock);
+    }
+
+    return;
+}
+
+} // namespace async
@@ -0,0 +1,108 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/optional.hpp>
+#include <async/thread.h>
+
+namespace async {
+
+// Split [begin, end) into contiguous chunks run by the workers of thread
+// and the calling thread, and block until all chunks are done.
+// Chunks start large and shrink to grain as the range runs out,
+// so uneven chunks still keep every participant busy.
+//
+// Param participant_num caps the participants, the calling thread 
+// included, pass thread.thread_num() + 1 to use every worker. An elastic
+// pool may change thread_num(), so read it once and size per participant
+// state with the same value.
+// Param body is called as body(participant, chunk_begin, chunk_end),
+// participant is 0 for the calling thread and 1..participant_num - 1 
+// for the workers, one participant never runs two chunks at the same time.
+void ParallelRun(Thread& thread, 
+                 size_t begin, 
+                 size_t end, 
+                 size_t grain,
+                 size_t participant_num,
+                 const boost::function<void(size_t, size_t, size_t)>& body);
+
+// Call function(chunk_begin, chunk_end) for contiguous chunks of 
+// [begin, end) in parallel, returns when all of them are done.
+// A chunk holds at least grain items, except the last one.
+template <typename F>
+void ParallelFor(Thread& thread, size_t begin, size_t end, size_t grain, F function) {
+    struct Body {
+        void operator()(size_t participant, size_t chunk_begin, size_t chunk_end) {
+            (*function)(chunk_begin, chunk_end);
+        }
+
+        F* function;
+    };
+
+    Body body = { &function };
+    ParallelRun(thread, begin, end, grain, thread.thread_num() + 1, body);
+}
+
+// Reduce [begin, end) in parallel.
+// map(chunk_begin, chunk_end) returns the value of a chunk, values are 
+// combined with reduce(a, b) which must be associative and commutative.
+// Returns identity for an empty range.
+template <typename T, typename M, typename R>
+T ParallelReduce(Thread& thread, 
+                 size_t begin, 
+                 size_t end, 
+                 size_t grain, 
+                 const T& identity, 
+                 M map, 
+                 R reduce) {
+    // Every participant folds its own chunks first.
+    size_t participant_num = thread.thread_num() + 1;
+    std::vector<boost::optional<T>> partial_list(participant_num);
+
+    struct Body {
+        void operator()(size_t participant, size_t chunk_begin, size_t chunk_end) {
+            boost::optional<T>& partial = (*partial_list)[participant];
+            if (partial) {
+                *partial = (*reduce)(*partial, (*map)(chunk_begin, chunk_end));
+            } else {
+                partial = (*map)(chunk_begin, chunk_end);
+            }
+        }
+
+        std::vector<boost::optional<T>>* partial_list;
+        M* map;
+        R* reduce;
+    };
+
+    Body body = { &partial_list, &map, &reduce };
+    ParallelRun(thread, begin, end, grain, participant_num, body);
+
+    T result = identity;
+    for (size_t i = 0; i < partial_list.size(); i++) {
+        if (partial_list[i]) {
+            result = reduce(result, *partial_list[i]);
+        }
+    }
+
+    return result;
+}
+
+}; // namespace async
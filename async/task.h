@@ -0,0 +1,259 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include <vector>
+#include <type_traits>
+
+namespace async {
+
+// Move-only task function.
+// Closures up to kInlineSize bytes, like a boost::bind of a member 
+// function with a shared_ptr argument, are stored without allocation.
+class Task {
+public:
+    static const size_t kInlineSize = 48;
+
+    Task() : ops_(NULL) {}
+
+    template <typename F, 
+              typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& function) : ops_(NULL) {
+        typedef typename std::decay<F>::type Function;
+        Init<Function>(std::forward<F>(function), std::integral_constant<bool,
+            sizeof(Function) <= kInlineSize && alignof(Function) <= alignof(Storage)>());
+    }
+
+    Task(Task&& other) : ops_(other.ops_) {
+        if (ops_ != NULL) {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = NULL;
+        }
+    }
+    Task& operator=(Task&& other) {
+        if (this != &other) {
+            clear();
+            ops_ = other.ops_;
+            if (ops_ != NULL) {
+                ops_->move(&storage_, &other.storage_);
+                other.ops_ = NULL;
+            }
+        }
+
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        clear();
+    }
+
+    void operator()() {
+        ops_->invoke(&storage_);
+    }
+
+    explicit operator bool() const {
+        return ops_ != NULL;
+    }
+
+    // Destroy the stored function.
+    void clear() {
+        if (ops_ != NULL) {
+            ops_->destroy(&storage_);
+            ops_ = NULL;
+        }
+    }
+
+private:
+    typedef typename std::aligned_storage<kInlineSize, alignof(void*) * 2>::type Storage;
+
+    template <typename Function, typename F>
+    void Init(F&& function, std::true_type) {
+        new (&storage_) Function(std::forward<F>(function));
+        ops_ = &InlineOps<Function>::ops;
+    }
+    template <typename Function, typename F>
+    void Init(F&& function, std::false_type) {
+        *reinterpret_cast<Function**>(&storage_) = new Function(std::forward<F>(function));
+        ops_ = &HeapOps<Function>::ops;
+    }
+
+    struct Ops {
+        void (*invoke)(void* storage);
+        // Move construct into dst and destroy src.
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename Function>
+    struct InlineOps {
+        static void Invoke(void* storage) {
+            (*static_cast<Function*>(storage))();
+        }
+        static void Move(void* dst, void* src) {
+            new (dst) Function(std::move(*static_cast<Function*>(src)));
+            static_cast<Function*>(src)->~Function();
+        }
+        static void Destroy(void* storage) {
+            static_cast<Function*>(storage)->~Function();
+        }
+
+        static const Ops ops;
+    };
+
+    template <typename Function>
+    struct HeapOps {
+        static void Invoke(void* storage) {
+            (**static_cast<Function**>(storage))();
+        }
+        static void Move(void* dst, void* src) {
+            *static_cast<Function**>(dst) = *static_cast<Function**>(src);
+        }
+        static void Destroy(void* storage) {
+            delete *static_cast<Function**>(storage);
+        }
+
+        static const Ops ops;
+    };
+
+    Storage storage_;
+    const Ops* ops_;
+};
+
+template <typename Function>
+const Task::Ops Task::InlineOps<Function>::ops = {
+    &Task::InlineOps<Function>::Invoke,
+    &Task::InlineOps<Function>::Move,
+    &Task::InlineOps<Function>::Destroy,
+};
+
+template <typename Function>
+const Task::Ops Task::HeapOps<Function>::ops = {
+    &Task::HeapOps<Function>::Invoke,
+    &Task::HeapOps<Function>::Move,
+    &Task::HeapOps<Function>::Destroy,
+};
+
+// Double ended task queue on a ring buffer.
+// The buffer only grows, so a steady stream of tasks allocates nothing.
+// Each task keeps the time it was posted, 0 when it was not measured,
+// and whether it is pinned, never dropped to make room.
+class TaskDeque {
+public:
+    TaskDeque() : head_(0), size_(0) {}
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    // Grow the buffer to at least capacity tasks.
+    void reserve(size_t capacity) {
+        while (entry_list_.size() < capacity) {
+            Grow();
+        }
+    }
+
+    void push_back(Task&& task, int64_t post_time = 0, bool pinned = false) {
+        if (size_ == entry_list_.size()) {
+            Grow();
+        }
+        Entry& entry = entry_list_[(head_ + size_) & (entry_list_.size() - 1)];
+        entry.task = std::move(task);
+        entry.post_time = post_time;
+        entry.pinned = pinned;
+        size_++;
+    }
+
+    // The queue must not be empty.
+    int64_t front_time() const {
+        return entry_list_[head_].post_time;
+    }
+    int64_t back_time() const {
+        return entry_list_[(head_ + size_ - 1) & (entry_list_.size() - 1)].post_time;
+    }
+    void pop_front(Task& task) {
+        task = std::move(entry_list_[head_].task);
+        head_ = (head_ + 1) & (entry_list_.size() - 1);
+        size_--;
+    }
+    void pop_back(Task& task) {
+        size_--;
+        task = std::move(entry_list_[(head_ + size_) & (entry_list_.size() - 1)].task);
+    }
+    // Take the oldest task that is not pinned, 
+    // returns false when every task is pinned.
+    bool pop_unpinned(Task& task) {
+        size_t mask = entry_list_.size() - 1;
+        size_t index = 0;
+        while (index < size_ && entry_list_[(head_ + index) & mask].pinned) {
+            index++;
+        }
+        if (index == size_) {
+            return false;
+        }
+
+        task = std::move(entry_list_[(head_ + index) & mask].task);
+        // The pinned tasks ahead of it move up one slot, in order.
+        for (size_t i = index; i > 0; i--) {
+            Entry& entry = entry_list_[(head_ + i) & mask];
+            Entry& previous = entry_list_[(head_ + i - 1) & mask];
+            entry.task = std::move(previous.task);
+            entry.post_time = previous.post_time;
+            entry.pinned = previous.pinned;
+        }
+        head_ = (head_ + 1) & mask;
+        size_--;
+
+        return true;
+    }
+
+private:
+    struct Entry {
+        Entry() : post_time(0), pinned(false) {}
+
+        Task task;
+        int64_t post_time;
+        bool pinned;
+    };
+
+    void Grow() {
+        std::vector<Entry> entry_list(entry_list_.empty() ? 16 : entry_list_.size() * 2);
+        for (size_t i = 0; i < size_; i++) {
+            Entry& entry = entry_list_[(head_ + i) & (entry_list_.size() - 1)];
+            entry_list[i].task = std::move(entry.task);
+            entry_list[i].post_time = entry.post_time;
+            entry_list[i].pinned = entry.pinned;
+        }
+        entry_list_.swap(entry_list);
+        head_ = 0;
+    }
+
+private:
+    size_t head_;
+    size_t size_;
+    std::vector<Entry> entry_list_;
+};
+
+}; // namespace async
@@ -18,12 +18,177 @@
 
 #include <async/thread.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <boost/bind.hpp>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define ASYNC_HAS_IO_URING_H
+#endif
+#endif
+
 namespace async {
 
-Thread::Thread(int thread_num) 
-       : is_running_(false) {
+namespace {
+
+// Worker run io_service handlers once every this many tasks,
+// so that socket events are not starved by a busy task queue.
+const int kPollInterval = 64;
+
+// A waiting lane gets one task after this many tasks of higher lanes.
+const int kStarvationLimit[] = { 0, 8, 32 };
+
+// Plain tasks of a lane get one turn after this many deadline tasks.
+const int kDeadlineStarvationLimit = 8;
+
+// A spinning worker polls the io_service and reads the clock 
+// once every this many rounds.
+const int kSpinCheckInterval = 64;
+
+// Pinned workers allocate this many tasks per lane up front.
+const size_t kPlacedLaneCapacity = 256;
+
+// The pool and worker index of the current thread.
+thread_local Thread* current_pool = NULL;
+thread_local size_t current_index = 0;
+
+int64_t NowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Tell the cpu this is a spin loop.
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Only the owning worker writes its counters, 
+// a plain load and store is enough.
+void Increase(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, 
+                  std::memory_order_relaxed);
+}
+
+// Histogram bucket of a time in microseconds.
+int Bucket(int64_t time) {
+    int bucket = 0;
+    while (time > 0 && bucket < Thread::Metrics::kBucketNum - 1) {
+        time >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+// Parse a cpu list like "0-3,8-11" from sysfs.
+bool ReadNumaNodeCpuList(int numa_node, std::vector<int>& cpu_list) {
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(numa_node) + "/cpulist");
+    std::string range;
+    while (std::getline(file, range, ',')) {
+        size_t pos = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = pos == std::string::npos ? first : std::atoi(range.c_str() + pos + 1);
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpu_list.push_back(cpu);
+        }
+    }
+
+    return !cpu_list.empty();
+}
+
+// A task posted with a cancellation token.
+struct CancellableTask {
+    void operator()() {
+        if (token.IsCancelled()) {
+            (*cancelled_num)++;
+            return;
+        }
+        task();
+    }
+
+    Task task;
+    CancellationToken token;
+    std::atomic<uint64_t>* cancelled_num;
+};
+
+} // namespace
+
+Thread::Thread(int thread_num, Mode mode) 
+       : is_running_(false)
+       , mode_(mode)
+       , created_queue_num_(0)
+       , sleeping_num_(0)
+       , next_queue_(0)
+       , elastic_(false)
+       , metrics_enabled_(false)
+       , min_thread_num_(thread_num)
+       , max_thread_num_(thread_num)
+       , scale_wait_(0)
+       , spin_time_(0)
+       , thread_num_(0)
+       , peak_thread_num_(0)
+       , last_grow_time_(0)
+       , grow_num_(0)
+       , retire_num_(0)
+       , max_reached_num_(0)
+       , alive_num_(0)
+       , capacity_(0)
+       , overflow_(BLOCK)
+       , queued_num_(0)
+       , blocked_num_(0)
+       , rejected_num_(0)
+       , dropped_num_(0)
+       , cancelled_num_(0)
+       , repeating_task_id_(1) {
     Start(thread_num);
 }
+Thread::Thread(const Options& options) 
+       : is_running_(false)
+       , mode_(options.mode)
+       , placement_(options.placement)
+       , created_queue_num_(0)
+       , sleeping_num_(0)
+       , next_queue_(0)
+       , elastic_(options.max_thread_num > options.thread_num)
+       , metrics_enabled_(options.enable_metrics)
+       , min_thread_num_(std::max(1, std::min(options.min_thread_num, options.thread_num)))
+       , max_thread_num_(std::max(options.max_thread_num, options.thread_num))
+       , scale_wait_(options.scale_wait.total_microseconds())
+       , idle_timeout_(options.idle_timeout)
+       , spin_time_(options.spin_time.is_pos_infinity() ? INT64_MAX : 
+                    std::max<int64_t>(options.spin_time.total_microseconds(), 0))
+       , thread_num_(0)
+       , peak_thread_num_(0)
+       , last_grow_time_(0)
+       , grow_num_(0)
+       , retire_num_(0)
+       , max_reached_num_(0)
+       , alive_num_(0)
+       , capacity_(options.capacity)
+       , overflow_(options.overflow)
+       , queued_num_(0)
+       , blocked_num_(0)
+       , rejected_num_(0)
+       , dropped_num_(0)
+       , cancelled_num_(0)
+       , repeating_task_id_(1) {
+    Start(options.thread_num);
+}
 Thread::~Thread() {
     Stop();
 }
@@ -33,13 +198,41 @@ void Thread::Start(int thread_num) {
         return;
     }
 
+#ifdef ASYNC_IO_URING_REACTOR
+    // Without epoll there is no other event loop to fall back to.
+    if (!IoUringSupported()) {
+        throw std::runtime_error("async::Thread: built with ASYNC_IO_URING_REACTOR, "
+                                 "but the kernel does not allow io_uring");
+    }
+#endif
+
     is_running_ = true;
+
+    size_t queue_num = mode_ == WORK_STEALING ? thread_num : 1;
+    if (queue_list_.size() < queue_num) {
+        created_queue_num_ = queue_list_.size();
+        queue_list_.resize(queue_num);
+    }
+    if (placement_.empty()) {
+        for (size_t i = 0; i < queue_num; i++) {
+            if (queue_list_[i].get() == NULL) {
+                queue_list_[i].reset(new TaskQueue());
+            }
+        }
+        created_queue_num_ = queue_num;
+    }
+
+    thread_mutex_.lock();
     for (int i = 0; i < thread_num; i++) {
-        boost::thread* task_thread = new boost::thread(boost::bind(
-            &Thread::TaskThread, this));
-        thread_list_.push_back(std::unique_ptr<boost::thread>());
-        thread_list_[thread_list_.size()-1].reset(task_thread);
+        AddThread();
     } 
+    thread_mutex_.unlock();
+
+    // Tasks can only be posted once every queue exists.
+    boost::mutex::scoped_lock lock(start_mutex_);
+    while (created_queue_num_ < queue_num) {
+        start_condition_.wait(lock);
+    }
 
     return;
 }
@@ -49,22 +242,193 @@ void Thread::Stop() {
         return;
     }
     
+    thread_mutex_.lock();
     is_running_ = false;
+    thread_mutex_.unlock();
     io_service_.stop();
 
+    // Blocked posters give up.
+    space_mutex_.lock();
+    space_condition_.notify_all();
+    space_mutex_.unlock();
+
     return;
 }
 
 void Thread::Join() {
+    // Elastic workers come and go, wait until none is left.
+    boost::mutex::scoped_lock lock(thread_mutex_);
+    while (alive_num_ > 0) {
+        thread_condition_.wait(lock);
+    }
+
     for (size_t i = 0; i < thread_list_.size(); i++) {
-        thread_list_[i]->join();
+        if (thread_list_[i]->joinable()) {
+            thread_list_[i]->join();
+        }
+    }
+
+    return;
+}
+
+bool Thread::PostTask(Task&& task) {
+    return PostTask(std::move(task), NORMAL);
+}
+
+bool Thread::PostTask(Task&& task, Priority priority) {
+    return Post(std::move(task), priority, true, 0, Task());
+}
+
+bool Thread::PostTask(Task&& task, const CancellationToken& token, Priority priority) {
+    return Post(MakeCancellable(std::move(task), token), priority, true, 0, Task());
+}
+
+bool Thread::TryPostTask(Task&& task, Priority priority) {
+    return Post(std::move(task), priority, false, 0, Task());
+}
+
+bool Thread::PostTaskWithDeadline(Task&& task, 
+                                  const boost::posix_time::time_duration& timeout,
+                                  Task&& expired_task, 
+                                  Priority priority) {
+    // A deadline already passed still goes through the queue,
+    // so expired_task runs on the pool like every other outcome.
+    int64_t deadline = NowMicros() + std::max<int64_t>(timeout.total_microseconds(), 0);
+    return Post(std::move(task), priority, true, deadline, std::move(expired_task));
+}
+
+bool Thread::Post(Task&& task, Priority priority, bool can_block, 
+                  int64_t deadline, Task&& expired_task) {
+    if (capacity_ > 0 && !Reserve(can_block)) {
+        rejected_num_++;
+        return false;
+    }
+
+    Enqueue(std::move(task), priority, deadline, std::move(expired_task), false);
+
+    return true;
+}
+
+void Thread::PostTaskOverCapacity(Task&& task, Priority priority) {
+    // Released like any other task when it is taken.
+    if (capacity_ > 0) {
+        queued_num_++;
     }
+    Enqueue(std::move(task), priority, 0, Task(), true);
 
     return;
 }
 
-void Thread::PostTask(const boost::function<void(void)>& task) {
-    io_service_.post(task);
+Task Thread::MakeCancellable(Task&& task, const CancellationToken& token) {
+    CancellableTask cancellable_task;
+    cancellable_task.task = std::move(task);
+    cancellable_task.token = token;
+    cancellable_task.cancelled_num = &cancelled_num_;
+
+    return Task(std::move(cancellable_task));
+}
+
+void Thread::Enqueue(Task&& task, Priority priority, int64_t deadline, Task&& expired_task, 
+                     bool pinned) {
+    size_t index = 0;
+    if (queue_list_.size() > 1) {
+        if (current_pool == this) {
+            index = current_index % queue_list_.size();
+        } else {
+            index = next_queue_++ % queue_list_.size();
+        }
+    }
+
+    // Post time is only taken when a pool grows or reports on it.
+    int64_t post_time = elastic_ || metrics_enabled_ ? NowMicros() : 0;
+    TaskQueue* queue = queue_list_[index].get();
+    queue->mutex_.lock();
+    if (deadline == 0) {
+        queue->Push(std::move(task), priority, post_time, pinned);
+    } else {
+        DeadlineTask deadline_task;
+        deadline_task.deadline = deadline;
+        deadline_task.post_time = post_time;
+        deadline_task.task = std::move(task);
+        deadline_task.expired_task = std::move(expired_task);
+        queue->PushDeadline(std::move(deadline_task), priority);
+    }
+    bool waiting = elastic_ && sleeping_num_ == 0 && 
+        post_time - queue->OldestPostTime() > scale_wait_;
+    queue->mutex_.unlock();
+
+    if (waiting) {
+        Grow();
+    }
+
+    // A parked worker is blocked in io_service::run_one, 
+    // post an empty handler to wake it up.
+    if (sleeping_num_ > 0) {
+        io_service_.post(&Thread::WakeUp);
+    }
+
+    return;
+}
+
+bool Thread::Dispatch(Task&& task, Priority priority) {
+    if (current_pool == this) {
+        task();
+        return true;
+    }
+
+    return PostTask(std::move(task), priority);
+}
+
+bool Thread::RunsTasksInCurrentThread() const {
+    return current_pool == this;
+}
+
+void Thread::PostDelayedTask(Task&& task,
+                             const boost::posix_time::time_duration& delay) {
+    std::shared_ptr<DelayedTask> delayed_task(new DelayedTask(io_service_));
+    delayed_task->task_ = std::move(task);
+    delayed_task->timer_.expires_from_now(delay);
+    delayed_task->timer_.async_wait(boost::bind(&Thread::DelayedTaskCallBack, 
+                                                _1, delayed_task));
+
+    return;
+}
+
+int Thread::PostRepeatingTask(Task&& task,
+                              const boost::posix_time::time_duration& interval) {
+    std::shared_ptr<RepeatingTask> repeating_task(new RepeatingTask(io_service_));
+    repeating_task->interval_ = interval;
+    repeating_task->task_ = std::move(task);
+
+    repeating_task_mutex_.lock();
+    int task_id = repeating_task_id_++;
+    repeating_task_list_[task_id] = repeating_task;
+    repeating_task_mutex_.unlock();
+
+    repeating_task->mutex_.lock();
+    repeating_task->timer_.expires_from_now(interval);
+    repeating_task->timer_.async_wait(boost::bind(&Thread::RepeatingTaskCallBack, 
+                                                  _1, repeating_task));
+    repeating_task->mutex_.unlock();
+
+    return task_id;
+}
+
+void Thread::CancelRepeatingTask(int task_id) {
+    repeating_task_mutex_.lock();
+    auto iter = repeating_task_list_.find(task_id);
+    if (iter == repeating_task_list_.end()) {
+        repeating_task_mutex_.unlock();
+        return;
+    }
+    std::shared_ptr<RepeatingTask> repeating_task = iter->second;
+    repeating_task_list_.erase(iter);
+    repeating_task_mutex_.unlock();
+
+    repeating_task->mutex_.lock();
+    repeating_task->cancelled_ = true;
+    repeating_task->timer_.cancel();
+    repeating_task->mutex_.unlock();
 
     return;
 }
@@ -73,7 +437,99 @@ boost::asio::io_service& Thread::io_service() {
     return io_service_;
 }
 
+Thread::Metrics Thread::metrics() const {
+    Metrics metrics;
+    for (size_t i = 0; i < queue_list_.size(); i++) {
+        metrics.queue_depth += queue_list_[i]->task_num_;
+    }
+    metrics.rejected_num = rejected_num_;
+    metrics.dropped_num = dropped_num_;
+    metrics.cancelled_num = cancelled_num_;
+    for (size_t i = 0; i < queue_list_.size(); i++) {
+        metrics.expired_num += queue_list_[i]->expired_num_;
+    }
+
+    int64_t now = NowMicros();
+    boost::mutex::scoped_lock lock(thread_mutex_);
+    for (size_t i = 0; i < worker_metrics_list_.size(); i++) {
+        const WorkerMetrics& worker_metrics = worker_metrics_list_[i];
+        Metrics::Worker worker;
+        worker.task_num = worker_metrics.task_num_.load(std::memory_order_relaxed);
+        worker.idle_time = worker_metrics.idle_time_.load(std::memory_order_relaxed);
+        // A parked worker has been idle since it parked.
+        int64_t park_time = worker_metrics.park_time_.load(std::memory_order_relaxed);
+        if (park_time != 0 && now > park_time) {
+            worker.idle_time += now - park_time;
+        }
+        metrics.task_num += worker.task_num;
+        metrics.idle_time += worker.idle_time;
+        metrics.worker_list.push_back(worker);
+
+        for (int j = 0; j < Metrics::kBucketNum; j++) {
+            metrics.wait_histogram[j] += worker_metrics.wait_histogram_[j].load(std::memory_order_relaxed);
+            metrics.run_histogram[j] += worker_metrics.run_histogram_[j].load(std::memory_order_relaxed);
+        }
+    }
+
+    return metrics;
+}
+
+Thread::Mode Thread::mode() const {
+    return mode_;
+}
+
+int Thread::thread_num() const {
+    return thread_num_;
+}
+
+Thread::ScaleStats Thread::scale_stats() const {
+    ScaleStats scale_stats;
+    scale_stats.thread_num = thread_num_;
+    scale_stats.peak_thread_num = peak_thread_num_;
+    scale_stats.grow_num = grow_num_;
+    scale_stats.retire_num = retire_num_;
+    scale_stats.max_reached_num = max_reached_num_;
+
+    return scale_stats;
+}
+
+Thread* Thread::Current() {
+    return current_pool;
+}
+
+const char* Thread::EventBackend() {
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+    return "io_uring";
+#elif defined(BOOST_ASIO_HAS_IO_URING)
+    return IoUringSupported() ? "epoll, files on io_uring" : "epoll";
+#else
+    return "epoll";
+#endif
+}
+
+bool Thread::IoUringSupported() {
+#if defined(ASYNC_HAS_IO_URING_H) && defined(__NR_io_uring_setup)
+    // Old kernels return ENOSYS, sandboxes often EPERM.
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = syscall(__NR_io_uring_setup, 1, &params);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool Thread::operator==(const boost::thread::id& id) const {
+    if (id == boost::this_thread::get_id()) {
+        return current_pool == this;
+    }
+
+    boost::mutex::scoped_lock lock(thread_mutex_);
     for (size_t i = 0; i < thread_list_.size(); i++) {
         if (thread_list_[i]->get_id() == id) {
             return true;
@@ -83,24 +539,633 @@ bool Thread::operator==(const boost::thread::id& id) const {
     return false;
 }
 bool Thread::operator!=(const boost::thread::id& id) const {
-    for (size_t i = 0; i < thread_list_.size(); i++) {
-        if (thread_list_[i]->get_id() == id) {
-            return false;
+    return !(*this == id);
+}
+
+void Thread::TaskThread(size_t index, WorkerMetrics* worker_metrics) {
+    bool retired = false;
+    if (is_running_) {
+        current_pool = this;
+        current_index = index;
+
+        if (!placement_.empty()) {
+            Place(index);
         }
+
+        retired = RunTasks(index, worker_metrics);
+
+        current_pool = NULL;
+    }
+
+    thread_mutex_.lock();
+    if (retired) {
+        retired_index_list_.push_back(index);
+    } else {
+        thread_num_--;
+    }
+    alive_num_--;
+    thread_condition_.notify_all();
+    thread_mutex_.unlock();
+    
+    return;
+}
+
+bool Thread::RunTasks(size_t index, WorkerMetrics* worker_metrics) {
+    boost::asio::io_service::work work(io_service_);
+    std::chrono::microseconds idle_timeout(idle_timeout_.total_microseconds());
+    Task task;
+    int64_t post_time = 0;
+    int task_count = 0;
+    while (!io_service_.stopped()) {
+        if (PopTask(index, task, post_time) || StealTask(index, task, post_time)) {
+            RunTask(task, post_time, worker_metrics);
+            if (++task_count % kPollInterval == 0) {
+                io_service_.poll();
+            }
+            continue;
+        }
+
+        if (io_service_.poll_one() > 0) {
+            continue;
+        }
+
+        if (spin_time_ > 0 && Spin()) {
+            continue;
+        }
+
+        // Check the queues again after announcing the sleep, 
+        // a task counted before that will be seen here,
+        // a task counted after that will post a wake up handler.
+        sleeping_num_++;
+        if (PopTask(index, task, post_time) || StealTask(index, task, post_time)) {
+            sleeping_num_--;
+            RunTask(task, post_time, worker_metrics);
+            continue;
+        }
+
+        if (worker_metrics != NULL) {
+            worker_metrics->park_time_.store(NowMicros(), std::memory_order_relaxed);
+        }
+        size_t handler_num = elastic_ ? io_service_.run_one_for(idle_timeout) : 
+                                        io_service_.run_one();
+        sleeping_num_--;
+        if (worker_metrics != NULL) {
+            int64_t park_time = worker_metrics->park_time_.load(std::memory_order_relaxed);
+            worker_metrics->park_time_.store(0, std::memory_order_relaxed);
+            Increase(worker_metrics->idle_time_, NowMicros() - park_time);
+        }
+
+        // An elastic worker idle for idle_timeout retires.
+        if (!elastic_ || handler_num > 0 || io_service_.stopped() || !Retire()) {
+            continue;
+        }
+
+        // Its wake up handler may have been meant for a task posted
+        // while retiring, that task is not left behind.
+        if (PopTask(index, task, post_time) || StealTask(index, task, post_time)) {
+            thread_num_++;
+            RunTask(task, post_time, worker_metrics);
+            continue;
+        }
+        retire_num_++;
+
+        return true;
+    }
+
+    return false;
+}
+
+void Thread::RunTask(Task& task, int64_t post_time, WorkerMetrics* worker_metrics) {
+    // An expired deadline task without an expired_task.
+    if (!task) {
+        return;
+    }
+
+    if (post_time == 0) {
+        task();
+        task.clear();
+        return;
+    }
+
+    int64_t start_time = NowMicros();
+    // The task waited too long while no worker was idle.
+    if (elastic_ && sleeping_num_ == 0 && start_time - post_time > scale_wait_) {
+        Grow();
+    }
+
+    task();
+    task.clear();
+
+    if (worker_metrics != NULL) {
+        Increase(worker_metrics->task_num_, 1);
+        Increase(worker_metrics->wait_histogram_[Bucket(start_time - post_time)], 1);
+        Increase(worker_metrics->run_histogram_[Bucket(NowMicros() - start_time)], 1);
+    }
+
+    return;
+}
+
+void Thread::Place(size_t index) {
+#ifdef __linux__
+    std::vector<int> cpu_list;
+    if (!placement_.cpu_list.empty()) {
+        cpu_list.push_back(placement_.cpu_list[index % placement_.cpu_list.size()]);
+    } else {
+        ReadNumaNodeCpuList(placement_.numa_node, cpu_list);
+    }
+
+    if (!cpu_list.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (size_t i = 0; i < cpu_list.size(); i++) {
+            CPU_SET(cpu_list[i], &cpu_set);
+        }
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    }
+#endif
+
+    // Allocated and first touched after pinning, 
+    // the queue pages are placed on this worker's node.
+    if (index < queue_list_.size() && queue_list_[index].get() == NULL) {
+        std::unique_ptr<TaskQueue> queue(new TaskQueue());
+        for (int i = 0; i < kPriorityNum; i++) {
+            queue->lane_list_[i].reserve(kPlacedLaneCapacity);
+        }
+
+        boost::mutex::scoped_lock lock(start_mutex_);
+        queue_list_[index].swap(queue);
+        created_queue_num_++;
+        start_condition_.notify_all();
+    }
+
+    // Stealing looks at every queue.
+    boost::mutex::scoped_lock lock(start_mutex_);
+    while (created_queue_num_ < queue_list_.size()) {
+        start_condition_.wait(lock);
+    }
+
+    return;
+}
+
+bool Thread::Spin() {
+    int64_t spin_end = spin_time_ == INT64_MAX ? INT64_MAX : NowMicros() + spin_time_;
+    for (int spin_count = 1; !io_service_.stopped(); spin_count++) {
+        // Only the counters are read, the queue locks stay free.
+        for (size_t i = 0; i < queue_list_.size(); i++) {
+            if (queue_list_[i]->task_num_ > 0) {
+                return true;
+            }
+        }
+
+        // Handlers and the clock are checked less often.
+        if (spin_count % kSpinCheckInterval == 0) {
+            if (io_service_.poll_one() > 0) {
+                return true;
+            }
+            if (NowMicros() >= spin_end) {
+                return false;
+            }
+        }
+
+        CpuRelax();
+    }
+
+    return false;
+}
+
+bool Thread::PopTask(size_t index, Task& task, int64_t& post_time) {
+    TaskQueue* queue = queue_list_[index % queue_list_.size()].get();
+    if (queue->task_num_ == 0) {
+        return false;
+    }
+
+    queue->mutex_.lock();
+    if (queue->task_num_ == 0) {
+        queue->mutex_.unlock();
+        return false;
+    }
+    post_time = queue->PopFront(task);
+    queue->mutex_.unlock();
+
+    if (capacity_ > 0) {
+        Release();
     }
 
     return true;
 }
 
-void Thread::TaskThread() {
+bool Thread::StealTask(size_t index, Task& task, int64_t& post_time) {
+    size_t queue_num = queue_list_.size();
+    for (size_t i = 1; i < queue_num; i++) {
+        TaskQueue* queue = queue_list_[(index + i) % queue_num].get();
+        if (queue->task_num_ == 0) {
+            continue;
+        }
+
+        boost::mutex::scoped_lock lock(queue->mutex_);
+        if (queue->task_num_ == 0) {
+            continue;
+        }
+
+        // Steal from the back, the owner works on the front.
+        post_time = queue->PopBack(task);
+        lock.unlock();
+
+        if (capacity_ > 0) {
+            Release();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+bool Thread::Reserve(bool can_block) {
+    while (true) {
+        size_t queued_num = queued_num_;
+        if (queued_num < capacity_) {
+            if (queued_num_.compare_exchange_weak(queued_num, queued_num + 1)) {
+                return true;
+            }
+            continue;
+        }
+
+        if (overflow_ == DROP_OLDEST) {
+            // The slot of the dropped task goes to the new one.
+            if (DropOldest()) {
+                dropped_num_++;
+                return true;
+            }
+            // Only pinned tasks left, or a worker took one meanwhile.
+            if (queued_num_ >= capacity_) {
+                return false;
+            }
+            continue;
+        }
+
+        if (overflow_ == REJECT || !can_block || !is_running_) {
+            return false;
+        }
+
+        // Workers waiting on their own pool would never drain it,
+        // they go over the capacity instead.
+        if (current_pool == this) {
+            queued_num_++;
+            return true;
+        }
+
+        blocked_num_++;
+        boost::mutex::scoped_lock lock(space_mutex_);
+        while (queued_num_ >= capacity_ && is_running_) {
+            space_condition_.wait(lock);
+        }
+        blocked_num_--;
+    }
+}
+
+void Thread::Release() {
+    queued_num_--;
+
+    // Taken under the lock, a poster about to wait does not miss it.
+    if (blocked_num_ > 0) {
+        space_mutex_.lock();
+        space_condition_.notify_one();
+        space_mutex_.unlock();
+    }
+
+    return;
+}
+
+bool Thread::DropOldest() {
+    Task task;
+    for (size_t i = 0; i < queue_list_.size(); i++) {
+        TaskQueue* queue = queue_list_[i].get();
+        if (queue->task_num_ == 0) {
+            continue;
+        }
+
+        queue->mutex_.lock();
+        if (queue->task_num_ == 0) {
+            queue->mutex_.unlock();
+            continue;
+        }
+        bool popped = queue->PopOldest(task);
+        queue->mutex_.unlock();
+        if (!popped) {
+            continue;
+        }
+
+        // Destroyed here, out of the queue lock.
+        task.clear();
+
+        return true;
+    }
+
+    return false;
+}
+
+void Thread::AddThread() {
+    size_t index = thread_list_.size();
+    if (!retired_index_list_.empty()) {
+        index = retired_index_list_.back();
+        retired_index_list_.pop_back();
+        // The retired worker has returned, this does not block.
+        if (thread_list_[index]->joinable()) {
+            thread_list_[index]->join();
+        }
+    } else {
+        thread_list_.push_back(std::unique_ptr<boost::thread>());
+    }
+
+    WorkerMetrics* worker_metrics = NULL;
+    if (metrics_enabled_) {
+        while (worker_metrics_list_.size() <= index) {
+            worker_metrics_list_.emplace_back();
+        }
+        worker_metrics = &worker_metrics_list_[index];
+    }
+
+    alive_num_++;
+    int thread_num = ++thread_num_;
+    if (thread_num > peak_thread_num_) {
+        peak_thread_num_ = thread_num;
+    }
+
+    thread_list_[index].reset(new boost::thread(boost::bind(
+        &Thread::TaskThread, this, index, worker_metrics)));
+
+    return;
+}
+
+void Thread::Grow() {
+    if (!elastic_) {
+        return;
+    }
+
+    // One worker at a time, it gets scale_wait to drain the queue.
+    int64_t now = NowMicros();
+    int64_t last_grow_time = last_grow_time_;
+    if (now - last_grow_time < scale_wait_ || 
+        !last_grow_time_.compare_exchange_strong(last_grow_time, now)) {
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(thread_mutex_);
     if (!is_running_) {
         return;
     }
+    if (thread_num_ >= max_thread_num_) {
+        max_reached_num_++;
+        return;
+    }
+
+    AddThread();
+    grow_num_++;
+
+    return;
+}
+
+bool Thread::Retire() {
+    int thread_num = thread_num_;
+    while (thread_num > min_thread_num_) {
+        if (thread_num_.compare_exchange_weak(thread_num, thread_num - 1)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Thread::DelayedTaskCallBack(const boost::system::error_code& err,
+                                 const std::shared_ptr<DelayedTask>& delayed_task) {
+    if (err) {
+        return;
+    }
+
+    delayed_task->task_();
+
+    return;
+}
+
+void Thread::RepeatingTaskCallBack(const boost::system::error_code& err,
+                                   const std::shared_ptr<RepeatingTask>& repeating_task) {
+    if (err) {
+        return;
+    }
+
+    repeating_task->mutex_.lock();
+    if (repeating_task->cancelled_) {
+        repeating_task->mutex_.unlock();
+        return;
+    }
+    repeating_task->mutex_.unlock();
+
+    repeating_task->task_();
+
+    repeating_task->mutex_.lock();
+    if (!repeating_task->cancelled_) {
+        repeating_task->timer_.expires_at(repeating_task->timer_.expires_at() + 
+                                          repeating_task->interval_);
+        repeating_task->timer_.async_wait(boost::bind(&Thread::RepeatingTaskCallBack, 
+                                                      _1, repeating_task));
+    }
+    repeating_task->mutex_.unlock();
 
-    boost::asio::io_service::work work(io_service_);
-    io_service_.run();
-    
     return;
 }
 
+Thread::Metrics::Metrics() 
+               : queue_depth(0)
+               , task_num(0)
+               , idle_time(0)
+               , rejected_num(0)
+               , dropped_num(0)
+               , expired_num(0)
+               , cancelled_num(0) {
+    for (int i = 0; i < kBucketNum; i++) {
+        wait_histogram[i] = 0;
+        run_histogram[i] = 0;
+    }
+}
+
+int64_t Thread::Metrics::Percentile(const uint64_t* histogram, double fraction) {
+    uint64_t total = 0;
+    for (int i = 0; i < kBucketNum; i++) {
+        total += histogram[i];
+    }
+
+    uint64_t count = 0;
+    for (int i = 0; i < kBucketNum; i++) {
+        count += histogram[i];
+        if (count > 0 && count >= total * fraction) {
+            return int64_t(1) << i;
+        }
+    }
+
+    return 0;
+}
+
+Thread::WorkerMetrics::WorkerMetrics() 
+                     : task_num_(0)
+                     , idle_time_(0)
+                     , park_time_(0) {
+    for (int i = 0; i < Metrics::kBucketNum; i++) {
+        wait_histogram_[i] = 0;
+        run_histogram_[i] = 0;
+    }
+}
+
+Thread::TaskQueue::TaskQueue() 
+                 : task_num_(0)
+                 , deadline_sequence_(0)
+                 , expired_num_(0) {
+    for (int i = 0; i < kPriorityNum; i++) {
+        skip_num_[i] = 0;
+        plain_skip_num_[i] = 0;
+    }
+}
+
+void Thread::TaskQueue::Push(Task&& task, Priority priority, int64_t post_time, bool pinned) {
+    lane_list_[priority].push_back(std::move(task), post_time, pinned);
+    task_num_++;
+
+    return;
+}
+
+void Thread::TaskQueue::PushDeadline(DeadlineTask&& deadline_task, Priority priority) {
+    std::vector<DeadlineTask>& deadline_list = deadline_list_[priority];
+    deadline_task.sequence = deadline_sequence_++;
+    deadline_list.push_back(std::move(deadline_task));
+    std::push_heap(deadline_list.begin(), deadline_list.end());
+    task_num_++;
+
+    return;
+}
+
+int64_t Thread::TaskQueue::PopFront(Task& task) {
+    int lane = 0;
+    while (LaneEmpty(lane)) {
+        lane++;
+    }
+
+    // The lowest starved lane goes first.
+    for (int i = kPriorityNum - 1; i > lane; i--) {
+        if (!LaneEmpty(i) && skip_num_[i] >= kStarvationLimit[i]) {
+            lane = i;
+            break;
+        }
+    }
+
+    for (int i = lane + 1; i < kPriorityNum; i++) {
+        if (!LaneEmpty(i)) {
+            skip_num_[i]++;
+        }
+    }
+    skip_num_[lane] = 0;
+
+    if (TakeDeadline(lane)) {
+        return PopDeadline(lane, task);
+    }
+
+    int64_t post_time = lane_list_[lane].front_time();
+    lane_list_[lane].pop_front(task);
+    task_num_--;
+
+    return post_time;
+}
+
+int64_t Thread::TaskQueue::PopBack(Task& task) {
+    int lane = 0;
+    while (LaneEmpty(lane)) {
+        lane++;
+    }
+
+    // Same order as PopFront, from the other end of the deque.
+    if (TakeDeadline(lane)) {
+        return PopDeadline(lane, task);
+    }
+
+    int64_t post_time = lane_list_[lane].back_time();
+    lane_list_[lane].pop_back(task);
+    task_num_--;
+
+    return post_time;
+}
+
+bool Thread::TaskQueue::PopOldest(Task& task) {
+    for (int lane = kPriorityNum - 1; lane >= 0; lane--) {
+        if (lane_list_[lane].pop_unpinned(task)) {
+            task_num_--;
+            return true;
+        }
+        // Deadline tasks are never pinned.
+        if (!deadline_list_[lane].empty()) {
+            PopDeadline(lane, task);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int64_t Thread::TaskQueue::OldestPostTime() const {
+    int64_t post_time = 0;
+    for (int i = 0; i < kPriorityNum; i++) {
+        if (!lane_list_[i].empty() && 
+            (post_time == 0 || lane_list_[i].front_time() < post_time)) {
+            post_time = lane_list_[i].front_time();
+        }
+        // The heap top is the most urgent, not the oldest, close enough.
+        if (!deadline_list_[i].empty() && 
+            (post_time == 0 || deadline_list_[i].front().post_time < post_time)) {
+            post_time = deadline_list_[i].front().post_time;
+        }
+    }
+
+    return post_time;
+}
+
+bool Thread::TaskQueue::LaneEmpty(int lane) const {
+    return lane_list_[lane].empty() && deadline_list_[lane].empty();
+}
+
+bool Thread::TaskQueue::TakeDeadline(int lane) {
+    if (deadline_list_[lane].empty()) {
+        return false;
+    }
+    if (lane_list_[lane].empty()) {
+        return true;
+    }
+
+    if (plain_skip_num_[lane] >= kDeadlineStarvationLimit) {
+        plain_skip_num_[lane] = 0;
+        return false;
+    }
+    plain_skip_num_[lane]++;
+
+    return true;
+}
+
+int64_t Thread::TaskQueue::PopDeadline(int lane, Task& task) {
+    std::vector<DeadlineTask>& deadline_list = deadline_list_[lane];
+    std::pop_heap(deadline_list.begin(), deadline_list.end());
+    DeadlineTask& deadline_task = deadline_list.back();
+    int64_t post_time = deadline_task.post_time;
+    if (deadline_task.deadline < NowMicros()) {
+        task = std::move(deadline_task.expired_task);
+        expired_num_++;
+    } else {
+        task = std::move(deadline_task.task);
+    }
+    deadline_list.pop_back();
+    task_num_--;
+
+    return post_time;
+}
+
+void Thread::WakeUp() {
+
+}
+
 } // namespace async
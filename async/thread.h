@@ -18,22 +18,120 @@
 
 #pragma once
 
+#include <deque>
 #include <list>
 #include <map>
+#include <unordered_map>
+#include <atomic>
+#include <utility>
 #include <boost/thread/thread.hpp>
 #include <boost/asio.hpp>
 #include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <async/task.h>
+#include <async/cancellation.h>
 
 namespace async {
 
+template <typename T>
+class Future;
+class ScheduleAwaiter;
+
 // Thread pool class.
 // Maintained a thread pool and threaded message delivery.
 class Thread {
 public:
+    // Task scheduling mode of the pool.
+    enum Mode {
+        SHARED = 0,    // All workers share one FIFO task queue.
+        WORK_STEALING, // Each worker owns a task deque, idle workers steal.
+    };
+
+    // Task priority lanes, workers drain higher lanes first.
+    // A lower lane still gets a task after a bounded number of 
+    // higher lane tasks, so it is never starved.
+    enum Priority {
+        HIGH = 0,   // Latency critical work.
+        NORMAL,     // Default lane of PostTask.
+        BACKGROUND, // Batch work.
+    };
+
+    // What PostTask does when a bounded pool is full.
+    // Tasks posted with PostTaskOverCapacity are never dropped.
+    enum Overflow {
+        BLOCK = 0,   // Wait for room, a worker of the pool never waits.
+        REJECT,      // Drop the new task.
+        DROP_OLDEST, // Drop the oldest task of the lowest lane.
+    };
+
+    // Cpus the workers of a pool run on.
+    // Pinned workers allocate their own task queue, 
+    // so the queue memory is local to their NUMA node.
+    struct Placement {
+        Placement() : numa_node(-1) {}
+
+        bool empty() const { return cpu_list.empty() && numa_node < 0; }
+
+        // Worker i is pinned to cpu_list[i % size], empty for any cpu.
+        std::vector<int> cpu_list;
+        // Workers float on the cpus of this NUMA node, -1 for any node.
+        // Ignored when cpu_list is set.
+        int numa_node;
+    };
+
+    // Pool options, the defaults match Thread().
+    // The pool is elastic when max_thread_num is above thread_num:
+    // it starts thread_num workers, adds one when a task waited in 
+    // the queue longer than scale_wait, and retires a worker that 
+    // was idle for idle_timeout, keeping at least min_thread_num.
+    struct Options {
+        Options() : thread_num(1)
+                  , mode(SHARED)
+                  , min_thread_num(1)
+                  , max_thread_num(0)
+                  , scale_wait(boost::posix_time::milliseconds(10))
+                  , idle_timeout(boost::posix_time::seconds(30))
+                  , enable_metrics(false)
+                  , capacity(0)
+                  , overflow(BLOCK)
+                  , spin_time(boost::posix_time::time_duration()) {}
+
+        int thread_num;
+        Mode mode;
+        Placement placement;
+        int min_thread_num;
+        int max_thread_num;
+        boost::posix_time::time_duration scale_wait;
+        boost::posix_time::time_duration idle_timeout;
+        // Collect the Metrics, it costs three clock reads per task.
+        bool enable_metrics;
+        // Most tasks queued at once, 0 for no limit. Due timer tasks 
+        // go over it, the timer thread never waits on a pool.
+        size_t capacity;
+        Overflow overflow;
+        // An idle worker busy polls this long before it parks,
+        // a task posted meanwhile starts without a futex wake.
+        // Zero parks at once, pos_infin never parks; pin spinning 
+        // workers to their own cores with the placement.
+        boost::posix_time::time_duration spin_time;
+    };
+
+    // Scaling decisions of an elastic pool.
+    struct ScaleStats {
+        int thread_num;            // Workers running now.
+        int peak_thread_num;       // Most workers ever running.
+        uint64_t grow_num;         // Workers added for queue wait.
+        uint64_t retire_num;       // Idle workers retired.
+        uint64_t max_reached_num;  // Grows refused at max_thread_num.
+    };
+
     // Param thread_num is number of worker threads,
-    // The constructor will start the thread by default
-    Thread(int thread_num = 1);
+    // The constructor will start the thread by default.
+    // An ASYNC_IO_URING_REACTOR build throws std::runtime_error 
+    // when the kernel does not allow io_uring.
+    Thread(int thread_num = 1, Mode mode = SHARED);
+    explicit Thread(const Options& options);
     ~Thread();
 
     // Start the thread
@@ -45,21 +143,315 @@ public:
     void Join();
 
     // Post a task to the thread pool.
-    void PostTask(const boost::function<void(void)>& task);
+    // In WORK_STEALING mode a task posted from a worker of this pool
+    // is pushed to that worker's own deque.
+    // Returns false when a bounded pool is full and its overflow is 
+    // REJECT, or BLOCK once the pool stopped, the task is dropped.
+    bool PostTask(Task&& task);
+    bool PostTask(Task&& task, Priority priority);
+    // Post a task that is dropped, not run, 
+    // when token is cancelled before it starts.
+    bool PostTask(Task&& task, const CancellationToken& token, Priority priority = NORMAL);
+    // Post a task without ever waiting.
+    // Returns false when a bounded pool is full and its overflow is 
+    // BLOCK or REJECT, the task is dropped.
+    bool TryPostTask(Task&& task, Priority priority = NORMAL);
+    // Post a task that never waits and is never dropped, it goes over 
+    // the capacity of a bounded pool. For work whose loss would hang
+    // someone: due timers, actor drains, promises, coroutine resumes.
+    void PostTaskOverCapacity(Task&& task, Priority priority = NORMAL);
+
+    // Post a task that has to start within timeout.
+    // Within its lane it runs earliest deadline first, ahead of the
+    // tasks without a deadline, which still get one turn in nine.
+    // A task whose deadline has passed is dropped, expired_task runs 
+    // in its place when set, to fail fast.
+    bool PostTaskWithDeadline(Task&& task, 
+                              const boost::posix_time::time_duration& timeout,
+                              Task&& expired_task = Task(), 
+                              Priority priority = NORMAL);
+
+    // Run the task inline when called on a worker of this pool,
+    // post it otherwise. An inline task runs before the caller returns.
+    // There is no recursion guard, a task that dispatches itself again
+    // grows the stack on every hop, post now and then to unwind it.
+    // Returns false when the post fails like PostTask.
+    bool Dispatch(Task&& task, Priority priority = NORMAL);
+    // True on a worker of this pool, a thread local compare.
+    bool RunsTasksInCurrentThread() const;
 
+    // Post a task and get its return value through a future,
+    // defined in async/future.h. It goes over the capacity like 
+    // PostTaskOverCapacity, a waiter on the future is never left hanging.
+    template <typename F>
+    Future<decltype(std::declval<F&>()())> PostTaskWithResult(F&& function, 
+                                                              Priority priority = NORMAL);
+
+    // co_await thread.Schedule() resumes the coroutine on this pool,
+    // defined in async/coroutine.h.
+    ScheduleAwaiter Schedule(Priority priority = NORMAL);
+
+    // Post a task that runs once after delay.
+    // The deadline is kept by this pool's own io_service, 
+    // the task runs on a worker without going through the TimerDevice.
+    void PostDelayedTask(Task&& task,
+                         const boost::posix_time::time_duration& delay);
+
+    // Post a task that runs every interval on this pool.
+    // Returns the id to cancel it with CancelRepeatingTask.
+    int PostRepeatingTask(Task&& task,
+                          const boost::posix_time::time_duration& interval);
+    // Cancel a repeating task, the pending wait is released immediately.
+    void CancelRepeatingTask(int task_id);
+
+    // The io_service is run by every worker, 
+    // socket handlers bound to it are executed by the pool.
     boost::asio::io_service& io_service();
 
-    // Compare thread ids.
+    // Snapshot of the pool metrics, times are in microseconds.
+    // Histogram bucket i counts times below 2^i microseconds,
+    // the last bucket also counts everything longer.
+    struct Metrics {
+        static const int kBucketNum = 24;
+
+        struct Worker {
+            uint64_t task_num; // Tasks run by the worker.
+            uint64_t idle_time; // Time parked waiting for work.
+        };
+
+        Metrics();
+
+        // Upper bound of the bucket holding the given fraction, 
+        // Percentile(wait_histogram, 0.99) is the p99 queue wait.
+        static int64_t Percentile(const uint64_t* histogram, double fraction);
+
+        size_t queue_depth; // Tasks waiting in the queues.
+        uint64_t task_num;
+        uint64_t idle_time;
+        uint64_t rejected_num; // New tasks dropped by a full pool.
+        uint64_t dropped_num; // Old tasks dropped by DROP_OLDEST.
+        uint64_t expired_num; // Tasks dropped at their deadline.
+        uint64_t cancelled_num; // Tasks dropped by their token.
+        uint64_t wait_histogram[kBucketNum]; // Post to start.
+        uint64_t run_histogram[kBucketNum]; // Start to end.
+        // Indexed by worker slot, retired slots keep their counts.
+        std::vector<Worker> worker_list;
+    };
+    // Queue depth and dropped tasks are always filled in, 
+    // the rest needs enable_metrics.
+    Metrics metrics() const;
+
+    Mode mode() const;
+    // Number of worker threads.
+    int thread_num() const;
+    ScaleStats scale_stats() const;
+
+    // The pool of the calling worker thread, NULL off any pool.
+    static Thread* Current();
+
+    // Event loop of io_service(). Sockets run on epoll, or on io_uring
+    // in an ASYNC_IO_URING_REACTOR build. An ASYNC_IO_URING build runs
+    // files on io_uring when the kernel allows it.
+    static const char* EventBackend();
+    // Whether the running kernel lets this process set up an io_uring.
+    // async::File falls back to pread and pwrite without it,
+    // an ASYNC_IO_URING_REACTOR pool does not start.
+    static bool IoUringSupported();
+
+    // Compare thread ids, O(1) for the id of the calling thread.
     bool operator==(const boost::thread::id& id) const;
     bool operator!=(const boost::thread::id& id) const;
 
 private:
-    void TaskThread();
+    static const int kPriorityNum = BACKGROUND + 1;
+
+    // A task posted with a deadline, in microseconds.
+    struct DeadlineTask {
+        // Heap order, the earliest deadline on top, FIFO among equals.
+        bool operator<(const DeadlineTask& other) const {
+            return deadline != other.deadline ? deadline > other.deadline : 
+                                                sequence > other.sequence;
+        }
+
+        int64_t deadline;
+        uint64_t sequence;
+        int64_t post_time;
+        Task task;
+        Task expired_task;
+    };
+
+    // Task queue owned by one worker, or shared by all in SHARED mode.
+    struct TaskQueue {
+        TaskQueue();
+
+        // Called with mutex_ held and task_num_ > 0.
+        // PopFront takes from the highest lane that is due,
+        // PopBack steals the newest task of the highest lane,
+        // both return the post time of the task.
+        // A lane serves its deadline tasks first, but its plain tasks
+        // get a turn after kDeadlineStarvationLimit deadline tasks.
+        // An expired one yields its expired_task, possibly empty.
+        void Push(Task&& task, Priority priority, int64_t post_time, bool pinned);
+        void PushDeadline(DeadlineTask&& deadline_task, Priority priority);
+        int64_t PopFront(Task& task);
+        int64_t PopBack(Task& task);
+        // Take the oldest task of the lowest lane that is not pinned,
+        // returns false when all are pinned.
+        bool PopOldest(Task& task);
+        // Post time of the oldest task, 0 when not measured.
+        int64_t OldestPostTime() const;
+
+        bool LaneEmpty(int lane) const;
+        // Whether the next task of the lane comes from its heap,
+        // counts the turns the plain tasks missed.
+        bool TakeDeadline(int lane);
+        int64_t PopDeadline(int lane, Task& task);
+
+        // Read without the lock to skip empty queues.
+        std::atomic<size_t> task_num_;
+        boost::mutex mutex_;
+        TaskDeque lane_list_[kPriorityNum];
+        // Binary heaps of the deadline tasks of each lane.
+        std::vector<DeadlineTask> deadline_list_[kPriorityNum];
+        uint64_t deadline_sequence_;
+        // Higher lane tasks run while this lane was waiting.
+        int skip_num_[kPriorityNum];
+        // Deadline tasks run while the plain tasks of the lane waited.
+        int plain_skip_num_[kPriorityNum];
+        std::atomic<uint64_t> expired_num_;
+    };
+
+    // A task waiting on its own deadline_timer.
+    struct DelayedTask {
+        DelayedTask(boost::asio::io_service& io_service) 
+            : timer_(io_service) {}
+
+        boost::asio::deadline_timer timer_;
+        Task task_;
+    };
+
+    // A task rescheduled on its own deadline_timer after every run.
+    struct RepeatingTask {
+        RepeatingTask(boost::asio::io_service& io_service) 
+            : cancelled_(false)
+            , timer_(io_service) {}
+
+        // Guards timer_ against a concurrent cancel from another thread.
+        boost::mutex mutex_;
+        bool cancelled_;
+        boost::asio::deadline_timer timer_;
+        boost::posix_time::time_duration interval_;
+        Task task_;
+    };
+
+    // Counters of one worker, written only by that worker.
+    struct WorkerMetrics {
+        WorkerMetrics();
+
+        std::atomic<uint64_t> task_num_;
+        std::atomic<uint64_t> idle_time_;
+        // When the worker parked, 0 while it is not parked.
+        std::atomic<int64_t> park_time_;
+        std::atomic<uint64_t> wait_histogram_[Metrics::kBucketNum];
+        std::atomic<uint64_t> run_histogram_[Metrics::kBucketNum];
+        // Keeps the next worker's counters off this cache line.
+        char padding_[64];
+    };
+
+    void TaskThread(size_t index, WorkerMetrics* worker_metrics);
+    // Returns true when the worker retired.
+    bool RunTasks(size_t index, WorkerMetrics* worker_metrics);
+    void RunTask(Task& task, int64_t post_time, WorkerMetrics* worker_metrics);
+    // Busy poll up to spin_time_, true when work showed up.
+    bool Spin();
+    void Place(size_t index);
+
+    // Called with thread_mutex_ held.
+    void AddThread();
+    // Add a worker if the pool is elastic and the last grow settled.
+    void Grow();
+    // Take a worker out of thread_num_, false at min_thread_num.
+    bool Retire();
+
+    static void DelayedTaskCallBack(const boost::system::error_code& err,
+                                    const std::shared_ptr<DelayedTask>& delayed_task);
+    static void RepeatingTaskCallBack(const boost::system::error_code& err,
+                                      const std::shared_ptr<RepeatingTask>& repeating_task);
+
+    // The post time of the task is returned in post_time.
+    bool PopTask(size_t index, Task& task, int64_t& post_time);
+    bool StealTask(size_t index, Task& task, int64_t& post_time);
+
+    // Take a slot of a bounded pool, the overflow decides when it is full.
+    bool Reserve(bool can_block);
+    // Give back the slot of a task taken off a bounded pool.
+    void Release();
+    bool DropOldest();
+    // A deadline of 0 posts a task without one.
+    bool Post(Task&& task, Priority priority, bool can_block, 
+              int64_t deadline, Task&& expired_task);
+    // Wrap a task to be dropped when token is cancelled before it runs.
+    Task MakeCancellable(Task&& task, const CancellationToken& token);
+    void Enqueue(Task&& task, Priority priority, int64_t deadline, Task&& expired_task, 
+                 bool pinned);
+    static void WakeUp();
+
+    friend class TimerDevice;
 
 private:
     bool is_running_;
+    Mode mode_;
+    Placement placement_;
+    // Pinned workers create their queues, Start waits for them.
+    boost::mutex start_mutex_;
+    boost::condition_variable start_condition_;
+    size_t created_queue_num_;
+    std::atomic<int> sleeping_num_;
+    std::atomic<size_t> next_queue_;
+    std::vector<std::unique_ptr<TaskQueue>> queue_list_;
+
+    // Elastic scaling, times are in microseconds.
+    bool elastic_;
+    bool metrics_enabled_;
+    int min_thread_num_;
+    int max_thread_num_;
+    int64_t scale_wait_;
+    boost::posix_time::time_duration idle_timeout_;
+    // Microseconds an idle worker spins, 0 for none.
+    int64_t spin_time_;
+    std::atomic<int> thread_num_;
+    std::atomic<int> peak_thread_num_;
+    std::atomic<int64_t> last_grow_time_;
+    std::atomic<uint64_t> grow_num_;
+    std::atomic<uint64_t> retire_num_;
+    std::atomic<uint64_t> max_reached_num_;
+
+    // Workers are added and reaped while others look them up.
+    mutable boost::mutex thread_mutex_;
+    boost::condition_variable thread_condition_;
+    int alive_num_;
+    // Slots of retired workers, reused by the next grow.
+    std::vector<size_t> retired_index_list_;
     std::vector<std::unique_ptr<boost::thread>> thread_list_;
+    // Bounded pools count their queued tasks.
+    size_t capacity_;
+    Overflow overflow_;
+    std::atomic<size_t> queued_num_;
+    std::atomic<int> blocked_num_;
+    std::atomic<uint64_t> rejected_num_;
+    std::atomic<uint64_t> dropped_num_;
+    boost::mutex space_mutex_;
+    boost::condition_variable space_condition_;
+    std::atomic<uint64_t> cancelled_num_;
+
+    // Indexed by worker slot, a deque keeps the counters in place.
+    std::deque<WorkerMetrics> worker_metrics_list_;
     boost::asio::io_service io_service_;
+
+    // Declared after io_service_, the timers are destroyed first.
+    int repeating_task_id_;
+    boost::mutex repeating_task_mutex_;
+    std::unordered_map<int, std::shared_ptr<RepeatingTask>> repeating_task_list_;
 };
 
 }; // namespace async
\ No newline at end of file
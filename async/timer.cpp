@@ -18,18 +18,137 @@
 
 #include <async/timer.h>
 
+#include <algorithm>
+#include <boost/bind.hpp>
 #include <async/thread.h>
 
 namespace async {
 
-TimerDevice Timer::timer_device_;
+std::once_flag Timer::device_flag_;
+std::atomic<size_t> Timer::next_device_(0);
+std::vector<std::unique_ptr<TimerDevice>> Timer::device_list_;
 
-TimerDevice::TimerDevice() {
+namespace {
+
+// The shard index of the current thread, -1 before its first timer.
+thread_local int current_device = -1;
+
+} // namespace
+
+TimerDevice::TimerDevice()
+            : timer_(io_service_)
+            , armed_tick_(TimingWheel::kNever)
+            , resolution_(1000)
+            , start_time_(std::chrono::steady_clock::now())
+            , next_token_key_(1) {
     thread_ = boost::thread(boost::bind(
                 &TimerDevice::TimerThread, this));
 }
 TimerDevice::~TimerDevice() {
+    io_service_.stop();
+    thread_.join();
+}
+
+TimerDevice::TimerNode* TimerDevice::AddTimer(Task&& task,
+                                              const boost::posix_time::time_duration& expiry_time,
+                                              const std::shared_ptr<Thread>& task_thread,
+                                              bool repeat,
+                                              const boost::posix_time::time_duration& slack,
+                                              const CancellationToken* token) {
+    TimerNode* node = new TimerNode();
+    if (repeat) {
+        node->repeat_task.reset(new RepeatTask(std::move(task)));
+    } else {
+        node->task = std::move(task);
+    }
+    node->task_thread = task_thread;
+    node->device = this;
+    if (token != NULL) {
+        node->token.reset(new CancellationToken(*token));
+        mutex_.lock();
+        node->token_key = next_token_key_++;
+        mutex_.unlock();
+        // Before the node is linked, it may expire and be deleted at once.
+        node->token_callback = node->token->Register(
+            boost::bind(&TimerDevice::CancelTokenTimer, this, node->token_key));
+        if (node->token_callback == 0) {
+            delete node;
+            return NULL;
+        }
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    std::chrono::microseconds elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time_);
+    node->deadline_tick = ToTick(boost::posix_time::microseconds(elapsed.count()) + expiry_time);
+    // Round down, a timer never runs later than its slack allows.
+    node->slack_tick = std::max<int64_t>(slack.total_microseconds(), 0) / resolution_.count();
+    node->expire_tick = Align(node->deadline_tick, node->slack_tick);
+    if (repeat) {
+        uint64_t interval_tick = ToTick(expiry_time);
+        node->interval_tick = interval_tick > 0 ? interval_tick : 1;
+    }
+    wheel_.Add(node, elapsed.count() / resolution_.count());
+    if (node->token) {
+        token_list_[node->token_key] = node;
+        // Cancelled before it was linked, the callback found nothing.
+        if (node->token->IsCancelled() && UnlinkTokenTimer(node->token_key) != NULL) {
+            lock.unlock();
+            delete node;
+            return NULL;
+        }
+    }
+
+    // Earlier than the armed wake up, 
+    // the device thread has to rearm its timer.
+    if (node->expire_tick < armed_tick_) {
+        armed_tick_ = node->expire_tick;
+        io_service_.post(boost::bind(&TimerDevice::Arm, this));
+    }
+
+    return node;
+}
+
+void TimerDevice::CancelTimer(TimerNode* node) {
+    mutex_.lock();
+    wheel_.Remove(node);
+    mutex_.unlock();
+
+    delete node;
+
+    return;
+}
+
+void TimerDevice::CancelTokenTimer(uint64_t token_key) {
+    mutex_.lock();
+    TimerNode* node = UnlinkTokenTimer(token_key);
+    mutex_.unlock();
+
+    // Out of the lock, the task may hold anything.
+    delete node;
+
+    return;
+}
+
+TimerDevice::TimerNode* TimerDevice::UnlinkTokenTimer(uint64_t token_key) {
+    auto iter = token_list_.find(token_key);
+    if (iter == token_list_.end()) {
+        return NULL;
+    }
+    TimerNode* node = iter->second;
+    token_list_.erase(iter);
+    wheel_.Remove(node);
+
+    return node;
+}
+
+void TimerDevice::SetResolution(const std::chrono::microseconds& resolution) {
+    // Keep the current time on the same tick under the new resolution.
+    uint64_t now_tick = NowTick();
+    resolution_ = resolution;
+    start_time_ = std::chrono::steady_clock::now() - resolution_ * now_tick;
 
+    return;
 }
 
 void TimerDevice::TimerThread() {
@@ -39,28 +158,171 @@ void TimerDevice::TimerThread() {
     return;
 }
 
+void TimerDevice::Arm() {
+    // SetResolution may change the clock at the same time.
+    mutex_.lock();
+    uint64_t armed_tick = armed_tick_;
+    std::chrono::microseconds resolution = resolution_;
+    std::chrono::steady_clock::time_point start_time = start_time_;
+    mutex_.unlock();
+
+    if (armed_tick == TimingWheel::kNever) {
+        timer_.cancel();
+        return;
+    }
+
+    timer_.expires_at(start_time + resolution * armed_tick);
+    timer_.async_wait(boost::bind(&TimerDevice::OnTick, this, _1));
+
+    return;
+}
+
+void TimerDevice::OnTick(const boost::system::error_code& err) {
+    if (err == boost::asio::error::operation_aborted) {
+        return;
+    }
+
+    std::vector<TimingWheel::Node*> expired_list;
+    std::vector<Task> inline_task_list;
+    std::unordered_map<std::shared_ptr<Thread>, TaskBatch> batch_list;
+    // Posted out of the lock, a worker of a full pool may be 
+    // waiting on the lock to add or cancel a timer.
+    std::vector<std::pair<std::shared_ptr<Thread>, Task>> post_list;
+
+    mutex_.lock();
+    uint64_t now_tick = NowTick();
+    wheel_.Advance(now_tick, expired_list);
+    for (size_t i = 0; i < expired_list.size(); i++) {
+        TimerNode* node = static_cast<TimerNode*>(expired_list[i]);
+        if (node->interval_tick == 0) {
+            if (node->token) {
+                token_list_.erase(node->token_key);
+                node->token->Unregister(node->token_callback);
+            }
+            if (node->token && node->token->IsCancelled()) {
+                // Cancelled before expiry, never posted.
+            } else if (node->token) {
+                post_list.push_back(std::make_pair(node->task_thread, 
+                    node->task_thread->MakeCancellable(std::move(node->task), *node->token)));
+            } else if (node->task_thread.get() == NULL) {
+                inline_task_list.push_back(std::move(node->task));
+            } else if (node->slack_tick > 0) {
+                batch_list[node->task_thread].task_list.push_back(std::move(node->task));
+            } else {
+                post_list.push_back(std::make_pair(node->task_thread, std::move(node->task)));
+            }
+            delete node;
+            continue;
+        }
+
+        if (node->repeat_task->running.exchange(true)) {
+            // The previous run is still in flight, skip this fire.
+        } else if (node->slack_tick > 0) {
+            batch_list[node->task_thread].task_list.push_back(
+                boost::bind(&RepeatTask::Run, node->repeat_task));
+        } else {
+            post_list.push_back(std::make_pair(node->task_thread, 
+                Task(boost::bind(&RepeatTask::Run, node->repeat_task))));
+        }
+
+        // Repeat from the deadline, the slack does not add up.
+        node->deadline_tick += node->interval_tick;
+        if (node->deadline_tick <= now_tick) {
+            node->deadline_tick = now_tick + 1;
+        }
+        node->expire_tick = Align(node->deadline_tick, node->slack_tick);
+        wheel_.Add(node, now_tick);
+    }
+    armed_tick_ = wheel_.NextTick();
+    mutex_.unlock();
+
+    // Never blocks, a full pool does not stall the other timers.
+    for (size_t i = 0; i < post_list.size(); i++) {
+        post_list[i].first->PostTaskOverCapacity(std::move(post_list[i].second));
+    }
+    for (auto iter = batch_list.begin(); iter != batch_list.end(); iter++) {
+        if (iter->second.task_list.size() == 1) {
+            iter->first->PostTaskOverCapacity(std::move(iter->second.task_list[0]));
+        } else {
+            iter->first->PostTaskOverCapacity(std::move(iter->second));
+        }
+    }
+
+    // Out of the lock, they may create timer tasks again.
+    for (size_t i = 0; i < inline_task_list.size(); i++) {
+        inline_task_list[i]();
+    }
+
+    Arm();
+
+    return;
+}
+
+uint64_t TimerDevice::Align(uint64_t deadline_tick, uint64_t slack_tick) {
+    if (slack_tick == 0) {
+        return deadline_tick;
+    }
+
+    // The grid step is the largest power of two within the slack,
+    // the grids of different slacks share their points.
+    uint64_t step = 1;
+    while (step * 2 <= slack_tick) {
+        step *= 2;
+    }
+
+    return (deadline_tick + step - 1) & ~(step - 1);
+}
+
+void TimerDevice::RepeatTask::Run() {
+    task();
+    running = false;
+
+    return;
+}
+
+void TimerDevice::TaskBatch::operator()() {
+    for (size_t i = 0; i < task_list.size(); i++) {
+        task_list[i]();
+    }
+
+    return;
+}
+
+uint64_t TimerDevice::NowTick() const {
+    return (std::chrono::steady_clock::now() - start_time_) / resolution_;
+}
+
+uint64_t TimerDevice::ToTick(const boost::posix_time::time_duration& duration) const {
+    int64_t microseconds = duration.total_microseconds();
+    if (microseconds <= 0) {
+        return 0;
+    }
+
+    // Round up, a task never fires before its expiry time.
+    return (microseconds + resolution_.count() - 1) / resolution_.count();
+}
+
 Timer::Timer()
       : timer_id_(1) {
 
 }
 Timer::~Timer() {
-
+    for (auto iter = timer_list_.begin(); iter != timer_list_.end(); iter++) {
+        iter->second->device->CancelTimer(iter->second);
+    }
+    timer_list_.clear();
 }
 
-int Timer::CreateTimerTask(const boost::function<void(void)>& task, 
+int Timer::CreateTimerTask(Task&& task, 
                            const boost::posix_time::time_duration& expiry_time,
-                           const std::shared_ptr<Thread>& task_thread) {
-    mutex_.lock();
-    int timer_id = timer_id_++;
-    mutex_.unlock();
-
-    std::shared_ptr<boost::asio::deadline_timer> timer;
-    timer.reset(new boost::asio::deadline_timer(timer_device_.io_service_, expiry_time));
-    timer->async_wait(boost::bind(&Timer::TimerCallBack, this, _1, timer, 
-        timer_id, expiry_time, task, task_thread));
+                           const std::shared_ptr<Thread>& task_thread,
+                           const boost::posix_time::time_duration& slack) {
+    TimerDevice::TimerNode* node = Device().AddTimer(std::move(task), expiry_time, 
+                                                     task_thread, true, slack);
 
     mutex_.lock();
-    timer_list_[timer_id] = timer;
+    int timer_id = timer_id_++;
+    timer_list_[timer_id] = node;
     mutex_.unlock();
 
     return timer_id; 
@@ -68,40 +330,99 @@ int Timer::CreateTimerTask(const boost::function<void(void)>& task,
 
 void Timer::CancelTimerTask(int timer_id) {
     mutex_.lock();
-    timer_list_.erase(timer_id);
+    auto iter = timer_list_.find(timer_id);
+    if (iter == timer_list_.end()) {
+        mutex_.unlock();
+        return;
+    }
+    TimerDevice::TimerNode* node = iter->second;
+    timer_list_.erase(iter);
     mutex_.unlock();
 
+    node->device->CancelTimer(node);
+
     return;
 }
 
-void Timer::CreateOnceTimerTask(const boost::function<void(void)>& task,
+void Timer::CreateOnceTimerTask(Task&& task,
                                 const boost::posix_time::time_duration& expiry_time,
-                                const std::shared_ptr<Thread>& task_thread) {
-    std::shared_ptr<boost::asio::deadline_timer> timer;
-    timer.reset(new boost::asio::deadline_timer(timer_device_.io_service_, expiry_time));
-    timer->async_wait(boost::bind(&Timer::TimerCallBack, this, _1, timer, 
-        0, expiry_time, task, task_thread));
-}
-
-void Timer::TimerCallBack(const boost::system::error_code& err, 
-                          const std::shared_ptr<boost::asio::deadline_timer>& timer,
-                          int timer_id,
-                          const boost::posix_time::time_duration& expiry_time,
-                          const boost::function<void(void)>& task,
-                          const std::shared_ptr<Thread>& task_thread) {
-    mutex_.lock();
-    if (timer_id != 0 && timer_list_.find(timer_id) == timer_list_.end()) {
-        mutex_.unlock();
-        return;
+                                const std::shared_ptr<Thread>& task_thread,
+                                const boost::posix_time::time_duration& slack) {
+    Device().AddTimer(std::move(task), expiry_time, task_thread, false, slack);
+
+    return;
+}
+
+void Timer::CreateOnceTimerTask(Task&& task,
+                                const boost::posix_time::time_duration& expiry_time,
+                                const std::shared_ptr<Thread>& task_thread,
+                                const CancellationToken& token,
+                                const boost::posix_time::time_duration& slack) {
+    Device().AddTimer(std::move(task), expiry_time, task_thread, false, slack, &token);
+
+    return;
+}
+
+void Timer::CreateInlineTimerTask(Task&& task,
+                                  const boost::posix_time::time_duration& expiry_time) {
+    Device().AddTimer(std::move(task), expiry_time, std::shared_ptr<Thread>(), false, 
+                      boost::posix_time::time_duration());
+
+    return;
+}
+
+bool Timer::SetResolution(const boost::posix_time::time_duration& resolution) {
+    if (resolution.total_microseconds() <= 0) {
+        return false;
     }
-    mutex_.unlock();
+    Device();
+
+    // Every shard is locked, they change together or not at all.
+    for (size_t i = 0; i < device_list_.size(); i++) {
+        device_list_[i]->mutex_.lock();
+    }
+    bool pending = false;
+    for (size_t i = 0; i < device_list_.size(); i++) {
+        pending = pending || device_list_[i]->wheel_.size() > 0;
+    }
+    for (size_t i = 0; i < device_list_.size(); i++) {
+        if (!pending) {
+            device_list_[i]->SetResolution(std::chrono::microseconds(resolution.total_microseconds()));
+        }
+        device_list_[i]->mutex_.unlock();
+    }
+
+    return !pending;
+}
+
+bool Timer::SetShardNum(int shard_num) {
+    if (shard_num <= 0) {
+        return false;
+    }
+
+    bool created = false;
+    std::call_once(device_flag_, [shard_num, &created]() {
+        CreateDevices(shard_num);
+        created = true;
+    });
+
+    return created;
+}
 
-    task_thread->PostTask(task);
+TimerDevice& Timer::Device() {
+    std::call_once(device_flag_, &Timer::CreateDevices, 
+                   std::max<int>(1, boost::thread::hardware_concurrency()));
+
+    if (current_device < 0) {
+        current_device = next_device_++ % device_list_.size();
+    }
+
+    return *device_list_[current_device];
+}
 
-    if (timer_id != 0) {
-        timer->expires_at(timer->expires_at() + expiry_time) ;
-        timer->async_wait(boost::bind(&Timer::TimerCallBack, this, _1, timer, 
-            timer_id, expiry_time, task, task_thread));
+void Timer::CreateDevices(int shard_num) {
+    for (int i = 0; i < shard_num; i++) {
+        device_list_.push_back(std::unique_ptr<TimerDevice>(new TimerDevice()));
     }
 
     return;
@@ -18,27 +18,123 @@
 
 #pragma once
 
-#include <map>
+#include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <boost/thread/thread.hpp>
 #include <boost/asio.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
+#include <async/task.h>
+#include <async/cancellation.h>
+#include <async/timing_wheel.h>
 
 namespace async {
 
 class Thread;
+class SleepAwaiter;
 
 // Timer thread class.
-// All timers share one thread.
+// One shard of the timer backend, its thread drives a hierarchical 
+// timing wheel. Shards share nothing, each has its own lock.
 class TimerDevice {
+public:
+    // Stops the timer thread, pending tasks never run.
+    ~TimerDevice();
+
 private:
+    // The task of a loop timer, a fire is skipped while 
+    // the previous run is still in flight.
+    struct RepeatTask {
+        RepeatTask(Task&& task) : task(std::move(task)), running(false) {}
+        void Run();
+
+        Task task;
+        std::atomic<bool> running;
+    };
+
+    // A pending timer task linked in the wheel.
+    struct TimerNode : public TimingWheel::Node {
+        TimerNode() : interval_tick(0), deadline_tick(0), slack_tick(0), device(NULL), 
+                      token_key(0), token_callback(0) {}
+
+        // Zero for a timer task that executes once.
+        uint64_t interval_tick;
+        // The requested tick, expire_tick is it rounded up by the slack.
+        uint64_t deadline_tick;
+        // Zero for a timer without slack.
+        uint64_t slack_tick;
+        // Moved to the thread when a once timer expires.
+        Task task;
+        // Shared by every run of a loop timer.
+        std::shared_ptr<RepeatTask> repeat_task;
+        // NULL runs the task on the timer thread, for internal use only.
+        std::shared_ptr<Thread> task_thread;
+        // The shard the node is linked in.
+        TimerDevice* device;
+        // Set for a once timer created with a token.
+        std::unique_ptr<CancellationToken> token;
+        // The key in token_list_ and the callback that unlinks the node 
+        // when the token is cancelled.
+        uint64_t token_key;
+        int token_callback;
+    };
+
     TimerDevice();
-    ~TimerDevice();
+
+    // Link a new timer node, the node is owned by the device 
+    // until it expires once or is cancelled.
+    // Returns NULL if token is already cancelled.
+    TimerNode* AddTimer(Task&& task,
+                        const boost::posix_time::time_duration& expiry_time,
+                        const std::shared_ptr<Thread>& task_thread,
+                        bool repeat,
+                        const boost::posix_time::time_duration& slack,
+                        const CancellationToken* token = NULL);
+    void CancelTimer(TimerNode* node);
+    // Called on the thread cancelling the token, the node and
+    // its task are released at once.
+    void CancelTokenTimer(uint64_t token_key);
+    // Called with mutex_ held, returns NULL if the node is gone.
+    TimerNode* UnlinkTokenTimer(uint64_t token_key);
+    // Called with mutex_ held.
+    void SetResolution(const std::chrono::microseconds& resolution);
 
     void TimerThread();
+    void Arm();
+    void OnTick(const boost::system::error_code& err);
+
+    // Timers with slack expire on a shared grid, so that nearby 
+    // deadlines land on the same tick and wake the thread once.
+    static uint64_t Align(uint64_t deadline_tick, uint64_t slack_tick);
+    // Tasks of slack timers expired together on the same thread,
+    // posted as one task.
+    struct TaskBatch {
+        void operator()();
+
+        std::vector<Task> task_list;
+    };
+
+    uint64_t NowTick() const;
+    uint64_t ToTick(const boost::posix_time::time_duration& duration) const;
 
     boost::thread thread_;
     boost::asio::io_service io_service_;
+    boost::asio::steady_timer timer_;
+
+    // Guards everything below.
+    boost::mutex mutex_;
+    TimingWheel wheel_;
+    uint64_t armed_tick_;
+    std::chrono::microseconds resolution_;
+    std::chrono::steady_clock::time_point start_time_;
+    // Linked nodes of the timers created with a token.
+    std::unordered_map<uint64_t, TimerNode*> token_list_;
+    uint64_t next_token_key_;
 
     friend class Timer;
 };
@@ -47,23 +143,31 @@ private:
 // Can post tasks to the specified thread through the timer.
 class Timer {
 public:
-    typedef std::map<int, std::shared_ptr<boost::asio::deadline_timer>> TIMER_LIST;
+    typedef std::unordered_map<int, TimerDevice::TimerNode*> TIMER_LIST;
 
     Timer();
+    // Cancel all loop execution timer tasks of this timer.
     ~Timer();
   
     // Create a loop execution timer task, 
     // the task will be post to the execution thread execution.
+    // A run never overlaps the previous one, the fires due 
+    // while it is still running are skipped.
     //
     // Param task is task function.
     // Param expiry_time is timer interval time.
     // Param task_thread is thread executing the task.
+    // Param slack is how late the task may run, timer tasks with slack
+    // that fall due together are posted to their thread as one batch.
     // Returns the id of this timer task.
-    int CreateTimerTask(const boost::function<void(void)>& task, 
+    int CreateTimerTask(Task&& task, 
                         const boost::posix_time::time_duration& expiry_time,
-                        const std::shared_ptr<Thread>& task_thread);
+                        const std::shared_ptr<Thread>& task_thread,
+                        const boost::posix_time::time_duration& slack = 
+                            boost::posix_time::time_duration());
     
     // Cancel a loop execution timer task, 
+    // the pending task is released immediately.
     //
     // Param timer_id is CreateTimerTask return.
     void CancelTimerTask(int timer_id);
@@ -74,23 +178,57 @@ public:
     // Param task is task function.
     // Param expiry_time is timer interval time.
     // Param task_thread is thread executing the task.
-    void CreateOnceTimerTask(const boost::function<void(void)>& task, 
+    // Param slack is how late the task may run.
+    void CreateOnceTimerTask(Task&& task, 
+                             const boost::posix_time::time_duration& expiry_time,
+                             const std::shared_ptr<Thread>& task_thread,
+                             const boost::posix_time::time_duration& slack = 
+                                 boost::posix_time::time_duration());
+    // Create a timer task that executes once, unless token is cancelled 
+    // first. Cancel releases the pending task at once, a task cancelled
+    // after expiry is dropped in the queue of task_thread.
+    void CreateOnceTimerTask(Task&& task, 
                              const boost::posix_time::time_duration& expiry_time,
-                             const std::shared_ptr<Thread>& task_thread);
+                             const std::shared_ptr<Thread>& task_thread,
+                             const CancellationToken& token,
+                             const boost::posix_time::time_duration& slack = 
+                                 boost::posix_time::time_duration());
+
+    // Set the tick resolution of the timing wheel, default 1 millisecond.
+    // Expiry times are rounded up to a whole tick.
+    // Returns false if timer tasks are pending, the resolution is unchanged.
+    static bool SetResolution(const boost::posix_time::time_duration& resolution);
+
+    // Set the number of timer shards, each runs its own timer thread.
+    // A timer task goes to the shard of the thread creating it, 
+    // threads are spread over the shards in turn.
+    // Defaults to one shard per core, the shards are created with 
+    // the first timer task. Returns false once they exist.
+    static bool SetShardNum(int shard_num);
+
+    // co_await timer.Sleep(duration) resumes the coroutine after duration
+    // on the pool it was suspended on, defined in async/coroutine.h.
+    SleepAwaiter Sleep(const boost::posix_time::time_duration& duration);
 
 private:
-    void TimerCallBack(const boost::system::error_code& err, 
-                       const std::shared_ptr<boost::asio::deadline_timer>& timer,
-                       int timer_id,
-                       const boost::posix_time::time_duration& expiry_time,
-                       const boost::function<void(void)>& task,
-                       const std::shared_ptr<Thread>& task_thread);
+    // The task runs on the timer thread, it must only post or resume.
+    void CreateInlineTimerTask(Task&& task, 
+                               const boost::posix_time::time_duration& expiry_time);
+
+    // The shard of the calling thread.
+    static TimerDevice& Device();
+    static void CreateDevices(int shard_num);
+
+    friend class SleepAwaiter;
 
 private:
     int timer_id_;
     boost::mutex mutex_;
     TIMER_LIST timer_list_;
-    static TimerDevice timer_device_;
+
+    static std::once_flag device_flag_;
+    static std::atomic<size_t> next_device_;
+    static std::vector<std::unique_ptr<TimerDevice>> device_list_;
 };
 
 }; // namespace async
\ No newline at end of file
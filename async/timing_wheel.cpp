@@ -0,0 +1,183 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <async/timing_wheel.h>
+
+namespace async {
+
+const uint64_t TimingWheel::kNever;
+
+TimingWheel::TimingWheel()
+            : current_tick_(0)
+            , size_(0) {
+    for (size_t i = 0; i < kRootSize; i++) {
+        root_[i].prev = root_[i].next = &root_[i];
+    }
+    for (int level = 0; level < kLevelNum; level++) {
+        for (size_t i = 0; i < kLevelSize; i++) {
+            level_[level][i].prev = level_[level][i].next = &level_[level][i];
+        }
+    }
+}
+TimingWheel::~TimingWheel() {
+
+}
+
+void TimingWheel::Add(Node* node, uint64_t now_tick) {
+    if (node->linked()) {
+        Remove(node);
+    }
+
+    // No slot is linked, any tick is a valid start.
+    if (size_ == 0 && now_tick > current_tick_) {
+        current_tick_ = now_tick;
+    }
+
+    size_++;
+    Place(node);
+
+    return;
+}
+
+void TimingWheel::Remove(Node* node) {
+    if (!node->linked()) {
+        return;
+    }
+
+    size_--;
+    Unlink(node);
+
+    return;
+}
+
+void TimingWheel::Advance(uint64_t tick, std::vector<Node*>& expired_list) {
+    while (current_tick_ <= tick && size_ > 0) {
+        size_t index = current_tick_ & (kRootSize - 1);
+        if (index == 0) {
+            Cascade(0);
+        }
+
+        Node* head = &root_[index];
+        while (head->next != head) {
+            Node* node = head->next;
+            Unlink(node);
+            size_--;
+            expired_list.push_back(node);
+        }
+
+        current_tick_++;
+    }
+
+    // Nothing left to expire, jump straight to the target tick.
+    if (current_tick_ <= tick) {
+        current_tick_ = tick + 1;
+    }
+
+    return;
+}
+
+uint64_t TimingWheel::NextTick() const {
+    if (size_ == 0) {
+        return kNever;
+    }
+
+    // Only the root wheel is searched, 
+    // the higher levels are due at the next root wheel turn.
+    if ((current_tick_ & (kRootSize - 1)) == 0) {
+        return current_tick_;
+    }
+    uint64_t turn_tick = (current_tick_ | (kRootSize - 1)) + 1;
+    for (uint64_t tick = current_tick_; tick < turn_tick; tick++) {
+        const Node* head = &root_[tick & (kRootSize - 1)];
+        if (head->next != head) {
+            return tick;
+        }
+    }
+
+    return turn_tick;
+}
+
+uint64_t TimingWheel::current_tick() const {
+    return current_tick_;
+}
+
+size_t TimingWheel::size() const {
+    return size_;
+}
+
+void TimingWheel::Link(Node* head, Node* node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+void TimingWheel::Unlink(Node* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = node->next = NULL;
+}
+
+void TimingWheel::Place(Node* node) {
+    uint64_t expire_tick = node->expire_tick;
+    if (expire_tick < current_tick_) {
+        expire_tick = current_tick_;
+    }
+
+    uint64_t delta = expire_tick - current_tick_;
+    if (delta >= kMaxSpan) {
+        // Park it in the farthest slot, it is placed again on cascade.
+        delta = kMaxSpan - 1;
+        expire_tick = current_tick_ + delta;
+    }
+
+    if (delta < kRootSize) {
+        Link(&root_[expire_tick & (kRootSize - 1)], node);
+        return;
+    }
+
+    for (int level = 0; level < kLevelNum; level++) {
+        int shift = kRootBits + kLevelBits * (level + 1);
+        if (level == kLevelNum - 1 || delta < (1ULL << shift)) {
+            size_t index = (expire_tick >> (shift - kLevelBits)) & (kLevelSize - 1);
+            Link(&level_[level][index], node);
+            return;
+        }
+    }
+}
+
+void TimingWheel::Cascade(int level) {
+    int shift = kRootBits + kLevelBits * level;
+    size_t index = (current_tick_ >> shift) & (kLevelSize - 1);
+
+    // A full turn of this level, the next level cascades first.
+    if (index == 0 && level + 1 < kLevelNum) {
+        Cascade(level + 1);
+    }
+
+    Node* head = &level_[level][index];
+    while (head->next != head) {
+        Node* node = head->next;
+        Unlink(node);
+        Place(node);
+    }
+
+    return;
+}
+
+} // namespace async
@@ -0,0 +1,91 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+namespace async {
+
+// Hierarchical timing wheel.
+// Insert and cancel are O(1), far timers cascade down level by level.
+// Not thread safe, the owner serializes all calls.
+class TimingWheel {
+public:
+    // Intrusive wheel node, allocated and owned by the caller.
+    struct Node {
+        Node() : prev(NULL), next(NULL), expire_tick(0) {}
+        virtual ~Node() {}
+
+        bool linked() const { return next != NULL; }
+
+        Node* prev;
+        Node* next;
+        uint64_t expire_tick;
+    };
+
+    // NextTick return value of an empty wheel.
+    static const uint64_t kNever = ~0ULL;
+
+    TimingWheel();
+    ~TimingWheel();
+
+    // Link the node by its expire_tick, 
+    // a tick already passed expires on the next Advance.
+    // An empty wheel first jumps to now_tick, so the next Advance 
+    // does not step through every tick of a long idle.
+    void Add(Node* node, uint64_t now_tick);
+    // Unlink the node if it is still pending.
+    void Remove(Node* node);
+
+    // Process all ticks up to and including tick,
+    // expired nodes are unlinked and appended to expired_list.
+    void Advance(uint64_t tick, std::vector<Node*>& expired_list);
+
+    // The earliest tick that Advance has to be called for,
+    // or kNever when the wheel is empty.
+    uint64_t NextTick() const;
+
+    // The next tick to be processed.
+    uint64_t current_tick() const;
+    size_t size() const;
+
+private:
+    static const int kRootBits = 8;
+    static const int kLevelBits = 6;
+    static const int kLevelNum = 3;
+    static const size_t kRootSize = 1 << kRootBits;
+    static const size_t kLevelSize = 1 << kLevelBits;
+    static const uint64_t kMaxSpan = 1ULL << (kRootBits + kLevelBits * kLevelNum);
+
+    static void Link(Node* head, Node* node);
+    static void Unlink(Node* node);
+
+    void Place(Node* node);
+    void Cascade(int level);
+
+private:
+    uint64_t current_tick_;
+    size_t size_;
+    Node root_[kRootSize];
+    Node level_[kLevelNum][kLevelSize];
+};
+
+}; // namespace async
@@ -0,0 +1,723 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <http/http_loop.h>
+
+#include <algorithm>
+#include <curl/easy.h>
+#include <boost/bind.hpp>
+#include <http/http_request.h>
+
+namespace http {
+
+namespace {
+
+// Most easy handles a loop keeps for reuse.
+const size_t kHandlePoolSize = 256;
+// Most idle hosts a loop keeps the stats of.
+const size_t kRetiredHostNum = 256;
+
+// Only the loop thread writes its counters.
+void Increase(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, 
+                  std::memory_order_relaxed);
+}
+
+} // namespace
+
+std::string MapToUrlQuery(const std::map<std::string, std::string>& params) {
+    std::string result = "";
+    for (auto iter = params.begin(); iter != params.end(); iter++) {
+        if (result == "") {
+            result += iter->first + "=" + iter->second;
+        } else {
+            result += "&" + iter->first + "=" + iter->second;
+        }
+    }
+
+    return result;
+}
+
+HttpLoop::HttpLoop()
+         : still_running_(0)
+         , curl_m_(NULL)
+         , share_(NULL)
+         , is_limited_(false)
+         , request_num_(0)
+         , connection_num_(0)
+         , recycled_handle_num_(0)
+         , name_lookup_time_(0)
+         , connect_time_(0)
+         , tls_time_(0)
+         , http2_request_num_(0)
+         , connection_in_use_num_(0)
+         , stream_in_use_num_(0) {
+
+}
+HttpLoop::~HttpLoop() {
+    if (thread_.get() != NULL) {
+        thread_->Stop();
+        thread_->Join();
+    }
+
+    for (auto iter = callback_data_list_.begin(); iter != callback_data_list_.end(); iter++) {
+        curl_multi_remove_handle(curl_m_, iter->first);
+    }
+    request_list_.clear();
+    callback_data_list_.clear();
+    for (size_t i = 0; i < handle_pool_.size(); i++) {
+        curl_easy_cleanup(handle_pool_[i]);
+    }
+    handle_pool_.clear();
+    if (curl_m_ != NULL) {
+        curl_multi_cleanup(curl_m_);
+        curl_m_ = NULL;
+    }
+
+    return;
+}
+
+void HttpLoop::Start(const async::Thread::Options& options, 
+                     const Settings& settings, 
+                     CURLSH* share) {
+    settings_ = settings;
+    share_ = share;
+    is_limited_ = settings.max_requests > 0 || settings.max_host_requests > 0;
+    thread_.reset(new async::Thread(options));
+    thread_->PostTask(boost::bind(&HttpLoop::Init, this));
+
+    return;
+}
+
+async::Thread* HttpLoop::thread() {
+    return thread_.get();
+}
+
+void HttpLoop::AddConnectionStats(ConnectionStats& stats) const {
+    stats.request_num += request_num_;
+    stats.connection_num += connection_num_;
+    stats.recycled_handle_num += recycled_handle_num_;
+    stats.name_lookup_time += name_lookup_time_;
+    stats.connect_time += connect_time_;
+    stats.tls_time += tls_time_;
+    stats.http2_request_num += http2_request_num_;
+    stats.connection_in_use_num += connection_in_use_num_;
+    stats.stream_in_use_num += stream_in_use_num_;
+
+    return;
+}
+
+void HttpLoop::Init() {
+    curl_m_ = curl_multi_init();
+    curl_multi_setopt(curl_m_, CURLMOPT_SOCKETFUNCTION, sock_cb);
+    curl_multi_setopt(curl_m_, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(curl_m_, CURLMOPT_TIMERFUNCTION, multi_timer_cb);
+    curl_multi_setopt(curl_m_, CURLMOPT_TIMERDATA, this);
+    if (settings_.http_version != HTTP1_1) {
+        curl_multi_setopt(curl_m_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(curl_m_, CURLMOPT_MAX_CONCURRENT_STREAMS, 
+                          (long)settings_.max_connection_streams);
+    }
+    curl_multi_setopt(curl_m_, CURLMOPT_MAX_HOST_CONNECTIONS, 
+                      (long)settings_.max_host_connections);
+
+    return;
+}
+
+void HttpLoop::AddHttpRequestInThread(const std::shared_ptr<HttpRequest>& request) {
+    if (request == NULL || request_list_.find(request) != request_list_.end() ||
+        request->cancellation_token().IsCancelled()) {
+        return;
+    }
+
+    if (!is_limited_) {
+        StartHttpRequest(request, NULL);
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(host_mutex_);
+    HostQueue* host = OpenHost(request->host());
+    HostQueue::Waiting waiting;
+    waiting.request = request;
+    waiting.queue_time = std::chrono::steady_clock::now();
+    host->waiting_list[request->priority()].push_back(std::move(waiting));
+    host->stats.waiting_num++;
+    if (!host->is_listed) {
+        turn_list_.push_back(host);
+        host->is_listed = true;
+    }
+    StartWaitingRequests();
+
+    return;
+}
+
+void HttpLoop::StartHttpRequest(const std::shared_ptr<HttpRequest>& request, HostQueue* host) {
+    CURLData* curl_data = CreateCURLData(request);
+
+    request_list_[request].reset(curl_data);
+    stream_in_use_num_.store(request_list_.size(), std::memory_order_relaxed);
+    CallbackData& callback_data = callback_data_list_[curl_data->curl_];
+    callback_data.request = request;
+    callback_data.host = host;
+    if (host != NULL) {
+        host->stats.in_flight_num++;
+    }
+    curl_easy_setopt(curl_data->curl_, CURLOPT_WRITEDATA, &callback_data);
+    curl_multi_add_handle(curl_m_, curl_data->curl_);
+
+    return;
+}
+
+void HttpLoop::StartWaitingRequests() {
+    while (settings_.max_requests == 0 || (int)request_list_.size() < settings_.max_requests) {
+        // The first host in turn among those with the highest priority.
+        auto best = turn_list_.end();
+        int best_priority = HttpRequest::LOW + 1;
+        for (auto iter = turn_list_.begin(); iter != turn_list_.end(); iter++) {
+            HostQueue* host = *iter;
+            if (settings_.max_host_requests > 0 && 
+                (int)host->stats.in_flight_num >= settings_.max_host_requests) {
+                continue;
+            }
+            int priority = 0;
+            while (host->waiting_list[priority].empty()) {
+                priority++;
+            }
+            if (priority < best_priority) {
+                best = iter;
+                best_priority = priority;
+            }
+        }
+        if (best == turn_list_.end()) {
+            break;
+        }
+
+        HostQueue* host = *best;
+        HostQueue::Waiting waiting = std::move(host->waiting_list[best_priority].front());
+        host->waiting_list[best_priority].pop_front();
+        host->stats.waiting_num--;
+        // The turn is used, the host goes to the back.
+        turn_list_.erase(best);
+        if (host->stats.waiting_num > 0) {
+            turn_list_.push_back(host);
+        } else {
+            host->is_listed = false;
+        }
+
+        // Cancelled or added again while waiting.
+        if (waiting.request->cancellation_token().IsCancelled() || 
+            request_list_.find(waiting.request) != request_list_.end()) {
+            if (host->stats.waiting_num == 0 && host->stats.in_flight_num == 0) {
+                RetireHost(host);
+            }
+            continue;
+        }
+
+        uint64_t queue_time = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - waiting.queue_time).count();
+        host->stats.request_num++;
+        host->stats.queue_time += queue_time;
+        host->stats.max_queue_time = std::max(host->stats.max_queue_time, queue_time);
+        StartHttpRequest(waiting.request, host);
+    }
+
+    return;
+}
+
+void HttpLoop::FinishHttpRequest(HostQueue* host) {
+    if (host == NULL) {
+        return;
+    }
+
+    boost::mutex::scoped_lock lock(host_mutex_);
+    host->stats.in_flight_num--;
+    if (host->stats.waiting_num == 0 && host->stats.in_flight_num == 0) {
+        RetireHost(host);
+    }
+    StartWaitingRequests();
+
+    return;
+}
+
+HttpLoop::HostQueue* HttpLoop::OpenHost(const std::string& name) {
+    auto iter = host_list_.find(name);
+    if (iter != host_list_.end()) {
+        return &iter->second;
+    }
+
+    HostQueue& host = host_list_[name];
+    host.name = name;
+    auto retired_iter = retired_index_.find(name);
+    if (retired_iter != retired_index_.end()) {
+        host.stats = retired_iter->second->second;
+        retired_list_.erase(retired_iter->second);
+        retired_index_.erase(retired_iter);
+    }
+
+    return &host;
+}
+
+void HttpLoop::RetireHost(HostQueue* host) {
+    retired_list_.push_front(std::make_pair(host->name, host->stats));
+    retired_index_[host->name] = retired_list_.begin();
+    if (retired_list_.size() > kRetiredHostNum) {
+        retired_index_.erase(retired_list_.back().first);
+        retired_list_.pop_back();
+    }
+    // The key lives in the erased node.
+    std::string name = host->name;
+    host_list_.erase(name);
+
+    return;
+}
+
+void HttpLoop::AddHostStats(HOST_STATS_LIST& stats_list) {
+    boost::mutex::scoped_lock lock(host_mutex_);
+    for (auto iter = host_list_.begin(); iter != host_list_.end(); iter++) {
+        HostStats& stats = stats_list[iter->first];
+        stats.request_num += iter->second.stats.request_num;
+        stats.waiting_num += iter->second.stats.waiting_num;
+        stats.in_flight_num += iter->second.stats.in_flight_num;
+        stats.queue_time += iter->second.stats.queue_time;
+        stats.max_queue_time = std::max(stats.max_queue_time, iter->second.stats.max_queue_time);
+    }
+    for (auto iter = retired_list_.begin(); iter != retired_list_.end(); iter++) {
+        HostStats& stats = stats_list[iter->first];
+        stats.request_num += iter->second.request_num;
+        stats.queue_time += iter->second.queue_time;
+        stats.max_queue_time = std::max(stats.max_queue_time, iter->second.max_queue_time);
+    }
+
+    return;
+}
+void HttpLoop::PauseHttpRequestInThread(const std::shared_ptr<HttpRequest>& request) {
+    auto iter = request_list_.find(request);
+    if (iter == request_list_.end()) {
+        return;
+    }
+
+    curl_easy_pause(iter->second->curl_, CURLPAUSE_RECV);
+
+    return;
+}
+void HttpLoop::ResumeHttpRequestInThread(const std::shared_ptr<HttpRequest>& request) {
+    auto iter = request_list_.find(request);
+    if (iter == request_list_.end()) {
+        return;
+    }
+
+    // Delivers the paused chunk before it returns.
+    curl_easy_pause(iter->second->curl_, CURLPAUSE_CONT);
+
+    return;
+}
+void HttpLoop::CancelHttpRequestInThread(const std::shared_ptr<HttpRequest>& request) {
+    auto iter = request_list_.find(request);
+    if (iter == request_list_.end()) {
+        return;
+    }
+
+    curl_multi_remove_handle(curl_m_, iter->second->curl_);
+    HostQueue* host = callback_data_list_[iter->second->curl_].host;
+    callback_data_list_.erase(iter->second->curl_);
+    RecycleCURLData(iter->second.get());
+    request_list_.erase(iter);
+    stream_in_use_num_.store(request_list_.size(), std::memory_order_relaxed);
+    FinishHttpRequest(host);
+
+    return;
+}
+
+HttpLoop::CURLData* HttpLoop::CreateCURLData(const std::shared_ptr<HttpRequest>& request) {
+    CURLData* curl_data = new CURLData();
+    if (!handle_pool_.empty()) {
+        curl_data->curl_ = handle_pool_.back();
+        handle_pool_.pop_back();
+        Increase(recycled_handle_num_, 1);
+    } else {
+        curl_data->curl_ = curl_easy_init();
+    }
+    if (share_ != NULL) {
+        curl_easy_setopt(curl_data->curl_, CURLOPT_SHARE, share_);
+    }
+
+    std::string url = request->url();
+    if (!request->params().empty()) {
+        if (request->http_mode() == HttpRequest::HttpMode::GET) {
+            url += "?" + MapToUrlQuery(request->params());
+        } else {
+            curl_data->headers_ = curl_slist_append(curl_data->headers_, 
+                                                    "Content-Type: application/x-www-form-urlencoded");
+            curl_data->headers_ = curl_slist_append(curl_data->headers_, "Accept-Language: zh-cn");
+            curl_data->post_data_ = MapToUrlQuery(request->params());
+            curl_easy_setopt(curl_data->curl_, CURLOPT_HTTPHEADER, curl_data->headers_);
+            curl_easy_setopt(curl_data->curl_, CURLOPT_POSTFIELDSIZE, curl_data->post_data_.size());
+            curl_easy_setopt(curl_data->curl_, CURLOPT_POSTFIELDS, curl_data->post_data_.c_str());
+            curl_easy_setopt(curl_data->curl_, CURLOPT_POST, 1);
+        }
+    }
+
+    if (request->url().find("https://") != std::string::npos) {
+        curl_easy_setopt(curl_data->curl_, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(curl_data->curl_, CURLOPT_SSL_VERIFYHOST, 0L);
+    }
+
+    if (!request->cookie().empty()) {
+        curl_easy_setopt(curl_data->curl_, CURLOPT_COOKIE, request->cookie().c_str());
+    }  
+
+    curl_easy_setopt(curl_data->curl_, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl_data->curl_, CURLOPT_TIMEOUT, 10L);
+    curl_easy_setopt(curl_data->curl_, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl_data->curl_, CURLOPT_MAXREDIRS, 5L);
+    if (settings_.http_version == HTTP2) {
+        curl_easy_setopt(curl_data->curl_, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    } else if (settings_.http_version == HTTP2_PRIOR_KNOWLEDGE) {
+        curl_easy_setopt(curl_data->curl_, CURLOPT_HTTP_VERSION, 
+                         CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+    } else {
+        curl_easy_setopt(curl_data->curl_, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    }
+    if (settings_.http_version != HTTP1_1) {
+        // Wait for a stream on a connection being set up to the same 
+        // origin, instead of opening a connection of its own.
+        curl_easy_setopt(curl_data->curl_, CURLOPT_PIPEWAIT, 1L);
+    }
+    curl_easy_setopt(curl_data->curl_, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl_data->curl_, CURLOPT_WRITEFUNCTION, write_cb);
+    /* call this function to get a socket */
+    curl_easy_setopt(curl_data->curl_, CURLOPT_OPENSOCKETFUNCTION, opensocket);
+    curl_easy_setopt(curl_data->curl_, CURLOPT_OPENSOCKETDATA, this);
+    /* call this function to close a socket */
+    curl_easy_setopt(curl_data->curl_, CURLOPT_CLOSESOCKETFUNCTION, close_socket);
+    curl_easy_setopt(curl_data->curl_, CURLOPT_CLOSESOCKETDATA, this);
+
+    return curl_data;
+}
+
+void HttpLoop::RecycleCURLData(CURLData* curl_data) {
+    if (handle_pool_.size() >= kHandlePoolSize) {
+        return;
+    }
+
+    // Reset drops the options and the request pointers, 
+    // the handle stays attached to the caches of the loop.
+    curl_easy_reset(curl_data->curl_);
+    handle_pool_.push_back(curl_data->curl_);
+    curl_data->curl_ = NULL;
+
+    return;
+}
+
+void HttpLoop::UpdateConnectionStats(CURL* curl) {
+    long connection_num = 0;
+    curl_off_t name_lookup_time = 0;
+    curl_off_t connect_time = 0;
+    curl_off_t tls_time = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connection_num);
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &name_lookup_time);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect_time);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &tls_time);
+    long http_version = 0;
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &http_version);
+
+    // The times are from the start of the request, each includes the 
+    // previous step, a reused connection reports no connect.
+    Increase(request_num_, 1);
+    Increase(connection_num_, connection_num);
+    if (http_version == CURL_HTTP_VERSION_2_0) {
+        Increase(http2_request_num_, 1);
+    }
+    Increase(name_lookup_time_, name_lookup_time);
+    if (connect_time > name_lookup_time) {
+        Increase(connect_time_, connect_time - name_lookup_time);
+    }
+    if (tls_time > connect_time) {
+        Increase(tls_time_, tls_time - connect_time);
+    }
+
+    return;
+}
+
+void HttpLoop::HttpRequestComplete(CURLMsg* msg) {
+    if (!msg || !msg->easy_handle) {
+        return;
+    }
+
+    auto iter = callback_data_list_.find(msg->easy_handle);
+    if (iter == callback_data_list_.end()) {
+        return;
+    }
+
+    // test {
+    // int http_code = -1;
+    // if (msg->data.result == CURLE_OK) {
+    //     curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &http_code);
+    // }
+
+    int http_code = 200;
+    // }
+
+    if (http_code == 200 || http_code == 206) {
+        iter->second.request->set_status(HttpRequest::Status::SUCCESS);
+        iter->second.request->set_response(std::move(iter->second.buffer));
+    } else {
+        iter->second.request->set_status(HttpRequest::Status::FAILED);
+        iter->second.request->set_http_code(http_code);
+    }
+
+    if (!iter->second.request->cancellation_token().IsCancelled()) {
+        iter->second.request->delegate()->OnHttpRequestComplete(iter->second.request);
+    }
+
+    UpdateConnectionStats(msg->easy_handle);
+
+    curl_multi_remove_handle(curl_m_, msg->easy_handle);
+    auto request_iter = request_list_.find(iter->second.request);
+    if (request_iter != request_list_.end()) {
+        RecycleCURLData(request_iter->second.get());
+        request_list_.erase(request_iter);
+    }
+    stream_in_use_num_.store(request_list_.size(), std::memory_order_relaxed);
+    HostQueue* host = iter->second.host;
+    callback_data_list_.erase(msg->easy_handle);
+    FinishHttpRequest(host);
+
+    return;
+}
+
+int HttpLoop::multi_timer_cb(CURLM *multi, 
+                             long timeout_ms,
+                             void* userp) {
+    HttpLoop* loop = static_cast<HttpLoop*>(userp);
+    if(timeout_ms > 0) {
+        // update timer
+        loop->thread_->PostDelayedTask(boost::bind(&timer_cb, loop), 
+                                       boost::posix_time::millisec(timeout_ms));
+    } else if(timeout_ms == 0) {
+        // call timeout function as soon as possible, 
+        // curl refuses a socket action from inside its own callback
+        loop->thread_->PostTask(boost::bind(&timer_cb, loop));
+    }
+
+    return 0;
+}
+void HttpLoop::timer_cb(HttpLoop* loop) {
+    curl_multi_socket_action(loop->curl_m_, CURL_SOCKET_TIMEOUT, 0,
+                             &loop->still_running_);
+
+    loop->CheckMultiInfo();
+}
+int HttpLoop::sock_cb(CURL* easy, 
+                         curl_socket_t sock, 
+                         int what, 
+                         void* cbp, 
+                         void* sockp) {
+    HttpLoop* loop = static_cast<HttpLoop*>(cbp);
+    int* actionp = (int*)sockp;
+
+    if(what == CURL_POLL_REMOVE) {
+        remsock(actionp);
+    } else {
+        if(!actionp) {
+            addsock(loop, sock, easy, what);
+        } else {;
+            setsock(loop, actionp, sock, easy, what, *actionp);
+        }
+    }
+
+    return 0;
+}
+
+void HttpLoop::addsock(HttpLoop* loop,
+                       curl_socket_t sock, 
+                       CURL* easy, 
+                       int action) {
+    // fdp is used to store current action 
+    int* fdp = (int *)calloc(sizeof(int), 1);
+
+    setsock(loop, fdp, sock, easy, action, 0);
+    curl_multi_assign(loop->curl_m_, sock, fdp);
+}
+void HttpLoop::setsock(HttpLoop* loop,
+                       int *fdp, 
+                       curl_socket_t sock, 
+                       CURL* easy, 
+                       int act, 
+                       int oldact) {
+    auto iter = loop->socket_list_.find(sock);
+    if(iter == loop->socket_list_.end()) {
+        return;
+    }
+
+    boost::asio::ip::tcp::socket* tcp_socket = iter->second;
+    *fdp = act;
+
+    if(act == CURL_POLL_IN) {
+        if(oldact != CURL_POLL_IN && oldact != CURL_POLL_INOUT) {
+            tcp_socket->async_read_some(boost::asio::null_buffers(),
+                                        boost::bind(&event_cb, loop, sock,
+                                                    CURL_POLL_IN, _1, fdp));
+        }
+    } else if(act == CURL_POLL_OUT) {
+        if(oldact != CURL_POLL_OUT && oldact != CURL_POLL_INOUT) {
+            tcp_socket->async_write_some(boost::asio::null_buffers(),
+                                         boost::bind(&event_cb, loop, sock,
+                                                     CURL_POLL_OUT, _1, fdp));
+        }
+    } else if(act == CURL_POLL_INOUT) {
+        if(oldact != CURL_POLL_IN && oldact != CURL_POLL_INOUT) {
+            tcp_socket->async_read_some(boost::asio::null_buffers(),
+                                        boost::bind(&event_cb, loop, sock,
+                                                    CURL_POLL_IN, _1, fdp));
+        }
+        if(oldact != CURL_POLL_OUT && oldact != CURL_POLL_INOUT) {
+            tcp_socket->async_write_some(boost::asio::null_buffers(),
+                                         boost::bind(&event_cb, loop, sock,
+                                                     CURL_POLL_OUT, _1, fdp));
+        }
+    }
+
+    return;
+}
+void HttpLoop::remsock(int* fdp) {
+    if(fdp) {
+        free(fdp);
+    }
+
+    return;
+}
+void HttpLoop::event_cb(HttpLoop* loop,
+                        curl_socket_t sock, 
+                        int action, 
+                        const boost::system::error_code& error, 
+                        int *fdp) {
+    auto iter = loop->socket_list_.find(sock);
+    if(iter == loop->socket_list_.end()) {
+        return;
+    }
+
+    // make sure the event matches what are wanted 
+    if(*fdp == action || *fdp == CURL_POLL_INOUT) {
+        if(error) {
+            action = CURL_CSELECT_ERR;
+        }
+        curl_multi_socket_action(loop->curl_m_, sock, 
+                                 action, &loop->still_running_);
+
+        loop->CheckMultiInfo();
+
+        /* keep on watching.
+            * the socket may have been closed and/or fdp may have been changed
+            * in curl_multi_socket_action(), so check them both */
+        if(!error && (*fdp == action || *fdp == CURL_POLL_INOUT)) {
+            boost::asio::ip::tcp::socket* tcp_socket = iter->second;
+            if(action == CURL_POLL_IN) {
+                tcp_socket->async_read_some(boost::asio::null_buffers(),
+                                            boost::bind(&event_cb, loop, sock,
+                                                        action, _1, fdp));
+            }
+            if(action == CURL_POLL_OUT) {
+                tcp_socket->async_write_some(boost::asio::null_buffers(),
+                                             boost::bind(&event_cb, loop, sock,
+                                                         action, _1, fdp));
+            }
+        }
+    } 
+
+    return;
+}
+
+curl_socket_t HttpLoop::opensocket(void* clientp, 
+                                   curlsocktype purpose, 
+                                   struct curl_sockaddr* address) {
+    HttpLoop* loop = static_cast<HttpLoop*>(clientp);
+    curl_socket_t sockfd = CURL_SOCKET_BAD;
+
+    // restrict to IPv4
+    if(purpose == CURLSOCKTYPE_IPCXN && address->family == AF_INET) {
+        // create a tcp socket object 
+        boost::asio::ip::tcp::socket* tcp_socket =
+            new boost::asio::ip::tcp::socket(loop->thread_->io_service());
+
+        // open it and get the native handle
+        boost::system::error_code code;
+        tcp_socket->open(boost::asio::ip::tcp::v4(), code);
+
+        if(!code) {
+            sockfd = tcp_socket->native_handle();
+
+            // save it for monitoring 
+            loop->socket_list_[sockfd] = tcp_socket;
+            loop->connection_in_use_num_.store(loop->socket_list_.size(), 
+                                               std::memory_order_relaxed);
+        }
+    }
+
+    return sockfd;
+}
+int HttpLoop::close_socket(void* clientp, 
+                           curl_socket_t sock) {
+    HttpLoop* loop = static_cast<HttpLoop*>(clientp);
+    auto iter = loop->socket_list_.find(sock);
+    if(iter != loop->socket_list_.end()) {
+        delete iter->second;
+        loop->socket_list_.erase(iter);
+        loop->connection_in_use_num_.store(loop->socket_list_.size(), 
+                                           std::memory_order_relaxed);
+    }
+
+    return 0;
+}
+
+size_t HttpLoop::write_cb(void* buffer, 
+                          size_t size, 
+                          size_t count, 
+                          void* stream) {
+    CallbackData* callback_data = static_cast<CallbackData*>(stream);
+    HttpRequest::StreamDelegate* stream_delegate = callback_data->request->stream_delegate();
+    if (stream_delegate == NULL) {
+        callback_data->buffer.append((char*)buffer, size*count);
+        return size * count;
+    }
+
+    // A short write aborts the transfer of a cancelled request.
+    if (callback_data->request->cancellation_token().IsCancelled()) {
+        return 0;
+    }
+    if (!stream_delegate->OnHttpRequestData(callback_data->request, 
+                                            (const char*)buffer, size * count)) {
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
+    return size * count;
+}
+
+void HttpLoop::CheckMultiInfo() {
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while((msg = curl_multi_info_read(curl_m_, &msgs_left))) {
+        if(msg->msg == CURLMSG_DONE) {
+            HttpRequestComplete(msg);
+        }
+    }
+
+    return;
+}
+
+} // namespace http
\ No newline at end of file
@@ -0,0 +1,285 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#pragma once 
+
+#include <string>
+#include <map>
+#include <list>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <curl/curl.h>
+#include <async/async.h>
+#include <boost/thread/mutex.hpp>
+#include <http/http_request.h>
+
+namespace http {
+
+// Http event loop class.
+// One shard of the HttpManager: a thread driving its own multi handle,
+// with the sockets and requests of that handle. Everything but Start 
+// runs on the loop thread, loops share nothing.
+class HttpLoop {
+public:
+    struct HostQueue;
+
+    // Callback data when the request is completed
+    struct CallbackData {
+        CallbackData() : host(NULL) {}
+        ~CallbackData() {}
+
+        std::string buffer;
+        std::shared_ptr<http::HttpRequest> request;
+        // Set when the loop has in-flight limits.
+        HostQueue* host;
+    };
+
+    // Request data to be used
+    struct CURLData {
+        CURLData() : curl_(NULL)
+                   , headers_(NULL) {}
+        ~CURLData() {
+            if (curl_ != NULL) {
+                curl_easy_cleanup(curl_);
+                curl_ = NULL;
+            }
+
+            if (headers_ != NULL) {
+                curl_slist_free_all(headers_);
+                headers_ = NULL;
+            }
+        }
+
+        CURL* curl_;
+        struct curl_slist* headers_;
+        std::string post_data_;
+    };
+
+    // Http version asked of the servers.
+    enum HttpVersion {
+        HTTP1_1 = 0,          // One request per connection at a time.
+        HTTP2,                // Http/2 where TLS negotiates it, http/1.1 otherwise.
+        HTTP2_PRIOR_KNOWLEDGE // Http/2 on every connection, also cleartext.
+    };
+
+    // Protocol settings, the same for every loop.
+    struct Settings {
+        Settings() : http_version(HTTP1_1)
+                   , max_host_connections(0)
+                   , max_connection_streams(100)
+                   , max_requests(0)
+                   , max_host_requests(0) {}
+
+        HttpVersion http_version;
+        // Most connections to one host, 0 for no limit. With http/2 
+        // requests wait for a stream on an existing connection 
+        // rather than open a new one, so one host gets at most
+        // max_host_connections * max_connection_streams streams.
+        int max_host_connections;
+        // Most concurrent http/2 streams on one connection.
+        int max_connection_streams;
+        // Most requests in flight on the loop and to one host, 
+        // 0 for no limit. Requests over a limit wait in a queue 
+        // per host, the hosts take turns.
+        int max_requests;
+        int max_host_requests;
+    };
+
+    // Requests of one host that went through the queue,
+    // times are in microseconds.
+    struct HostStats {
+        HostStats() : request_num(0)
+                    , waiting_num(0)
+                    , in_flight_num(0)
+                    , queue_time(0)
+                    , max_queue_time(0) {}
+
+        uint64_t request_num;    // Started so far.
+        uint64_t waiting_num;    // In the queue now.
+        uint64_t in_flight_num;  // Running now.
+        uint64_t queue_time;     // Sum over the started requests.
+        uint64_t max_queue_time;
+    };
+    typedef std::map<std::string, HostStats> HOST_STATS_LIST;
+
+    // The waiting requests of a host, one deque per priority.
+    struct HostQueue {
+        struct Waiting {
+            std::shared_ptr<HttpRequest> request;
+            std::chrono::steady_clock::time_point queue_time;
+        };
+
+        HostQueue() : is_listed(false) {}
+
+        std::string name;
+        std::deque<Waiting> waiting_list[HttpRequest::LOW + 1];
+        // In the turn list of the loop.
+        bool is_listed;
+        HostStats stats;
+    };
+
+    // Connection setup cost of the completed requests, 
+    // times are sums in microseconds.
+    struct ConnectionStats {
+        ConnectionStats() : request_num(0)
+                          , connection_num(0)
+                          , recycled_handle_num(0)
+                          , name_lookup_time(0)
+                          , connect_time(0)
+                          , tls_time(0)
+                          , http2_request_num(0)
+                          , connection_in_use_num(0)
+                          , stream_in_use_num(0) {}
+
+        uint64_t request_num;
+        uint64_t connection_num;      // New connections opened.
+        uint64_t recycled_handle_num; // Requests served by a pooled easy handle.
+        uint64_t name_lookup_time;
+        uint64_t connect_time;        // Tcp connect after the name lookup.
+        uint64_t tls_time;            // Tls handshake after the connect.
+        uint64_t http2_request_num;   // Requests answered over http/2.
+        // Now, not summed over time. A stream is a request in flight,
+        // on http/1.1 it has a connection of its own.
+        uint64_t connection_in_use_num;
+        uint64_t stream_in_use_num;
+    };
+
+    typedef std::map<std::shared_ptr<HttpRequest>, std::unique_ptr<CURLData>> REQUEST_LIST;
+    typedef std::map<CURL*, CallbackData> CB_DATA_LIST;
+    typedef std::map<curl_socket_t, boost::asio::ip::tcp::socket*> SOCKET_LIST;
+
+    HttpLoop();
+    // Stops the loop thread, pending requests are dropped.
+    ~HttpLoop();
+
+    // Create the loop thread, the multi handle is set up on it.
+    // Easy handles of the loop use share when it is not NULL.
+    void Start(const async::Thread::Options& options, 
+               const Settings& settings, 
+               CURLSH* share);
+
+    async::Thread* thread();
+    // Adds the stats of this loop to stats.
+    void AddConnectionStats(ConnectionStats& stats) const;
+    void AddHostStats(HOST_STATS_LIST& stats_list);
+
+    void AddHttpRequestInThread(const std::shared_ptr<HttpRequest>& request);
+    void CancelHttpRequestInThread(const std::shared_ptr<HttpRequest>& request);
+    // Only the body of a request is paused, its connection stays open.
+    void PauseHttpRequestInThread(const std::shared_ptr<HttpRequest>& request);
+    void ResumeHttpRequestInThread(const std::shared_ptr<HttpRequest>& request);
+
+private:
+    void Init();
+    void StartHttpRequest(const std::shared_ptr<HttpRequest>& request, HostQueue* host);
+    // Start the waiting requests the limits allow, 
+    // the highest priority first, hosts in turn.
+    // Called with host_mutex_ held.
+    void StartWaitingRequests();
+    // Called after a request of host left the multi handle.
+    void FinishHttpRequest(HostQueue* host);
+    // Find or create the queue of a host, with its retired stats.
+    // Called with host_mutex_ held.
+    HostQueue* OpenHost(const std::string& name);
+    // Erase a host with nothing waiting or in flight, its stats are 
+    // kept among the recently retired hosts.
+    // Called with host_mutex_ held.
+    void RetireHost(HostQueue* host);
+    void HttpRequestComplete(CURLMsg* msg);
+    CURLData* CreateCURLData(const std::shared_ptr<HttpRequest>& request);
+    // Keep the easy handle of a finished request for the next one.
+    void RecycleCURLData(CURLData* curl_data);
+    void UpdateConnectionStats(CURL* curl);
+    void CheckMultiInfo();
+
+    // Curl callbacks, the user data is the loop.
+    static int multi_timer_cb(CURLM* multi, 
+                              long timeout_ms,
+                              void* userp);
+    static void timer_cb(HttpLoop* loop);
+    static int sock_cb(CURL* easy, 
+                       curl_socket_t sock, 
+                       int what, 
+                       void* cbp, 
+                       void* sockp);
+    static void addsock(HttpLoop* loop,
+                        curl_socket_t sock, 
+                        CURL* easy, 
+                        int action);
+    static void setsock(HttpLoop* loop,
+                        int* fdp, 
+                        curl_socket_t sock, 
+                        CURL* easy, 
+                        int act, 
+                        int oldact);
+    static void remsock(int* fdp);
+    static void event_cb(HttpLoop* loop,
+                         curl_socket_t s, 
+                         int action, 
+                         const boost::system::error_code& error, 
+                         int* fdp);
+    static curl_socket_t opensocket(void* clientp, 
+                                    curlsocktype purpose, 
+                                    struct curl_sockaddr* address);
+    static int close_socket(void* clientp, 
+                            curl_socket_t sock);
+    static size_t write_cb(void* buffer, 
+                           size_t size, 
+                           size_t count, 
+                           void* stream);
+
+private:
+    int still_running_;
+    CURLM* curl_m_;
+    std::unique_ptr<async::Thread> thread_;
+    Settings settings_;
+    CURLSH* share_;
+    // Reset easy handles, they keep their buffers and cached state.
+    std::vector<CURL*> handle_pool_;
+    // Used with in-flight limits only. A host is only kept while it has
+    // requests waiting or in flight, the queues and the turn list never 
+    // point to an erased one.
+    bool is_limited_;
+    std::map<std::string, HostQueue> host_list_;
+    // Hosts with waiting requests, the front one has the next turn.
+    std::list<HostQueue*> turn_list_;
+    // Stats of the erased hosts, most recent first, capped in size.
+    typedef std::list<std::pair<std::string, HostStats>> RETIRED_LIST;
+    RETIRED_LIST retired_list_;
+    std::unordered_map<std::string, RETIRED_LIST::iterator> retired_index_;
+    // Guards the host stats against host_stats readers.
+    boost::mutex host_mutex_;
+    // Written by the loop thread only.
+    std::atomic<uint64_t> request_num_;
+    std::atomic<uint64_t> connection_num_;
+    std::atomic<uint64_t> recycled_handle_num_;
+    std::atomic<uint64_t> name_lookup_time_;
+    std::atomic<uint64_t> connect_time_;
+    std::atomic<uint64_t> tls_time_;
+    std::atomic<uint64_t> http2_request_num_;
+    std::atomic<uint64_t> connection_in_use_num_;
+    std::atomic<uint64_t> stream_in_use_num_;
+    REQUEST_LIST request_list_;
+    CB_DATA_LIST callback_data_list_;
+    SOCKET_LIST socket_list_;
+};
+
+}; // namespace http
\ No newline at end of file
@@ -18,8 +18,7 @@
 
 #include <http/http_manager.h>
 
-#include <curl/easy.h>
-#include <boost/thread/thread.hpp>
+#include <functional>
 #include <boost/bind.hpp>
 #include <http/http_request.h>
 
@@ -27,34 +26,19 @@ namespace http {
 
 HttpManager* HttpManager::http_manager_ = NULL;
 
-std::string MapToUrlQuery(const std::map<std::string, std::string>& params) {
-    std::string result = "";
-    for (auto iter = params.begin(); iter != params.end(); iter++) {
-        if (result == "") {
-            result += iter->first + "=" + iter->second;
-        } else {
-            result += "&" + iter->first + "=" + iter->second;
-        }
-    }
-
-    return result;
-}
-
 HttpManager::HttpManager()
             : is_running_(false)
-            , still_running_(0)
-            , curl_m_(NULL) {
+            , queue_capacity_(0)
+            , loop_num_(1)
+            , distribution_(ROUND_ROBIN)
+            , next_loop_(0)
+            , connection_sharing_(true)
+            , enable_metrics_(false)
+            , share_(NULL) {
 
 }
 HttpManager::~HttpManager() {
-    for (auto iter = callback_data_list_.begin(); iter != callback_data_list_.end(); iter++) {
-        curl_multi_remove_handle(curl_m_, iter->first);
-        curl_easy_cleanup(iter->first);
-    }
-    curl_multi_cleanup(curl_m_);
-    curl_m_ = NULL;
-    request_list_.clear();
-    callback_data_list_.clear();
+    Stop();
 
     return;
 }
@@ -67,341 +51,244 @@ HttpManager* HttpManager::GetInstance() {
     return http_manager_;
 }
 
-void HttpManager::Start() {
-    if (is_running_) {
-        return;
-    }
+void HttpManager::set_placement(const async::Thread::Placement& placement) {
+    placement_ = placement;
 
-    if (thread_.get() == NULL) {
-        thread_.reset(new async::Thread());
-        thread_->PostTask(boost::bind(&HttpManager::Start, this));
-        return;
-    }
+    return;
+}
 
-    is_running_ = true;
-    curl_global_init(CURL_GLOBAL_ALL);
-    curl_m_ = curl_multi_init();
-    curl_multi_setopt(curl_m_, CURLMOPT_SOCKETFUNCTION, sock_cb);
-    curl_multi_setopt(curl_m_, CURLMOPT_SOCKETDATA, curl_m_);
-    curl_multi_setopt(curl_m_, CURLMOPT_TIMERFUNCTION, multi_timer_cb);
-    curl_multi_setopt(curl_m_, CURLMOPT_TIMERDATA, curl_m_);
+void HttpManager::set_queue_capacity(size_t queue_capacity) {
+    queue_capacity_ = queue_capacity;
 
     return;
 }
 
-void HttpManager::AddHttpRequest(const std::shared_ptr<HttpRequest>& request) {
-    if (*thread_ != CURRENT_THREAD) {
-        thread_->PostTask(boost::bind(&HttpManager::AddHttpRequest, this, request));
-        return;
-    }
+void HttpManager::set_connection_sharing(bool connection_sharing) {
+    connection_sharing_ = connection_sharing;
 
-    if (request == NULL || request_list_.find(request) != request_list_.end()) {
-        return;
-    }
+    return;
+}
+
+void HttpManager::set_enable_metrics(bool enable_metrics) {
+    enable_metrics_ = enable_metrics;
+
+    return;
+}
+
+void HttpManager::set_http_version(HttpLoop::HttpVersion http_version) {
+    settings_.http_version = http_version;
 
-    CURLData* curl_data = CreateCURLData(request);
+    return;
+}
 
-    request_list_[request].reset(curl_data);
-    callback_data_list_[curl_data->curl_].request = request;
-    curl_multi_add_handle(curl_m_, curl_data->curl_);
+void HttpManager::set_max_host_connections(int max_host_connections) {
+    settings_.max_host_connections = std::max(max_host_connections, 0);
 
     return;
 }
-void HttpManager::CancelHttpRequest(const std::shared_ptr<HttpRequest>& request) {
-    if (*thread_ != CURRENT_THREAD) {
-        thread_->PostTask(boost::bind(&HttpManager::CancelHttpRequest, this, request));
-        return;
-    }
 
-    auto iter = request_list_.find(request);
-    if (iter == request_list_.end()) {
-        return;
-    }
+void HttpManager::set_max_connection_streams(int max_connection_streams) {
+    settings_.max_connection_streams = std::max(max_connection_streams, 1);
+
+    return;
+}
 
-    curl_multi_remove_handle(curl_m_, iter->second->curl_);
-    curl_easy_cleanup(iter->second->curl_);
-    callback_data_list_.erase(iter->second->curl_);
-    request_list_.erase(request);
+void HttpManager::set_max_requests(int max_requests) {
+    settings_.max_requests = std::max(max_requests, 0);
 
     return;
 }
 
-HttpManager::CURLData* HttpManager::CreateCURLData(const std::shared_ptr<HttpRequest>& request) {
-    CURLData* curl_data = new CURLData();
-    curl_data->curl_ = curl_easy_init();
-
-    std::string url = request->url();
-    if (!request->params().empty()) {
-        if (request->http_mode() == HttpRequest::HttpMode::GET) {
-            url += "?" + MapToUrlQuery(request->params());
-        } else {
-            curl_data->headers_ = curl_slist_append(curl_data->headers_, 
-                                                    "Content-Type: application/x-www-form-urlencoded");
-            curl_data->headers_ = curl_slist_append(curl_data->headers_, "Accept-Language: zh-cn");
-            curl_data->post_data_ = MapToUrlQuery(request->params());
-            curl_easy_setopt(curl_data->curl_, CURLOPT_HTTPHEADER, curl_data->headers_);
-            curl_easy_setopt(curl_data->curl_, CURLOPT_POSTFIELDSIZE, curl_data->post_data_.size());
-            curl_easy_setopt(curl_data->curl_, CURLOPT_POSTFIELDS, curl_data->post_data_.c_str());
-            curl_easy_setopt(curl_data->curl_, CURLOPT_POST, 1);
-        }
-    }
+void HttpManager::set_max_host_requests(int max_host_requests) {
+    settings_.max_host_requests = std::max(max_host_requests, 0);
 
-    if (request->url().find("https://") != std::string::npos) {
-        curl_easy_setopt(curl_data->curl_, CURLOPT_SSL_VERIFYPEER, 0L);
-        curl_easy_setopt(curl_data->curl_, CURLOPT_SSL_VERIFYHOST, 0L);
-    }
+    return;
+}
 
-    if (!request->cookie().empty()) {
-        curl_easy_setopt(curl_data->curl_, CURLOPT_COOKIE, request->cookie().c_str());
-    }  
-
-    curl_easy_setopt(curl_data->curl_, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl_data->curl_, CURLOPT_TIMEOUT, 10L);
-    curl_easy_setopt(curl_data->curl_, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl_data->curl_, CURLOPT_MAXREDIRS, 5L);
-    curl_easy_setopt(curl_data->curl_, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl_data->curl_, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl_data->curl_, CURLOPT_WRITEDATA, curl_data->curl_);
-    /* call this function to get a socket */
-    curl_easy_setopt(curl_data->curl_, CURLOPT_OPENSOCKETFUNCTION, opensocket);
-    /* call this function to close a socket */
-    curl_easy_setopt(curl_data->curl_, CURLOPT_CLOSESOCKETFUNCTION, close_socket);
-
-    return curl_data;
+void HttpManager::set_loop_num(int loop_num) {
+    loop_num_ = std::max(loop_num, 1);
+
+    return;
 }
 
-void HttpManager::HttpRequestComplete(CURLMsg* msg) {
-    if (!msg || !msg->easy_handle) {
-        return;
-    }
+void HttpManager::set_distribution(Distribution distribution) {
+    distribution_ = distribution;
+
+    return;
+}
 
-    auto iter = callback_data_list_.find(msg->easy_handle);
-    if (iter == callback_data_list_.end()) {
+void HttpManager::Start() {
+    if (is_running_) {
         return;
     }
 
-    // test {
-    // int http_code = -1;
-    // if (msg->data.result == CURLE_OK) {
-    //     curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &http_code);
-    // }
+    is_running_ = true;
+    curl_global_init(CURL_GLOBAL_ALL);
 
-    int http_code = 200;
-    // }
+    // The connection cache is not shared, curl does not support 
+    // sharing connections between concurrent threads.
+    if (connection_sharing_) {
+        share_ = curl_share_init();
+        curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lock_cb);
+        curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlock_cb);
+        curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
 
-    if (http_code == 200 || http_code == 206) {
-        iter->second.request->set_status(HttpRequest::Status::SUCCESS);
-        iter->second.request->set_response(iter->second.buffer);
-    } else {
-        iter->second.request->set_status(HttpRequest::Status::FAILED);
-        iter->second.request->set_http_code(http_code);
+    HttpLoop::Settings settings = settings_;
+    if (settings.max_requests > 0) {
+        settings.max_requests = (settings.max_requests + loop_num_ - 1) / loop_num_;
     }
 
-    iter->second.request->delegate()->OnHttpRequestComplete(iter->second.request);
+    for (int i = 0; i < loop_num_; i++) {
+        async::Thread::Options options;
+        options.placement = placement_;
+        if (!placement_.cpu_list.empty()) {
+            options.placement.cpu_list.assign(1, placement_.cpu_list[i % placement_.cpu_list.size()]);
+        }
+        options.enable_metrics = enable_metrics_;
+        options.capacity = queue_capacity_;
+        options.overflow = async::Thread::BLOCK;
 
-    curl_multi_remove_handle(curl_m_, msg->easy_handle);
-    request_list_.erase(iter->second.request);
-    callback_data_list_.erase(msg->easy_handle);
+        loop_list_.push_back(std::unique_ptr<HttpLoop>(new HttpLoop()));
+        loop_list_.back()->Start(options, settings, share_);
+    }
 
     return;
 }
 
-int HttpManager::multi_timer_cb(CURLM *multi, 
-                                long timeout_ms) {
-    if(timeout_ms > 0) {
-        // update timer
-        http_manager_->timer_.CreateOnceTimerTask(boost::bind(&timer_cb), 
-                                                  boost::posix_time::millisec(timeout_ms), 
-                                                  http_manager_->thread_);
-    } else if(timeout_ms == 0) {
-        // call timeout function immediately
-        timer_cb();
+void HttpManager::Stop() {
+    if (!is_running_) {
+        return;
     }
 
-    return 0;
+    // Each loop stops and joins its thread, then frees its handles.
+    loop_list_.clear();
+    if (share_ != NULL) {
+        curl_share_cleanup(share_);
+        share_ = NULL;
+    }
+    curl_global_cleanup();
+    is_running_ = false;
+
+    return;
 }
-void HttpManager::timer_cb() {
-    curl_multi_socket_action(http_manager_->curl_m_, CURL_SOCKET_TIMEOUT, 0,
-                             &http_manager_->still_running_);
 
-    check_multi_info();
+int HttpManager::loop_num() const {
+    return loop_list_.size();
 }
-int HttpManager::sock_cb(CURL* easy, 
-                         curl_socket_t sock, 
-                         int what, 
-                         void* cbp, 
-                         void* sockp) {
-    int* actionp = (int*)sockp;
-
-    if(what == CURL_POLL_REMOVE) {
-        remsock(actionp);
-    } else {
-        if(!actionp) {
-            addsock(sock, easy, what);
-        } else {;
-            setsock(actionp, sock, easy, what, *actionp);
-        }
+
+async::Thread::Metrics HttpManager::thread_metrics(int loop_index) const {
+    if (loop_index < 0 || loop_index >= (int)loop_list_.size()) {
+        return async::Thread::Metrics();
     }
 
-    return 0;
+    return loop_list_[loop_index]->thread()->metrics();
 }
 
-void HttpManager::addsock(curl_socket_t sock, 
-                          CURL* easy, 
-                          int action) {
-    // fdp is used to store current action 
-    int* fdp = (int *)calloc(sizeof(int), 1);
+HttpLoop::ConnectionStats HttpManager::connection_stats() const {
+    HttpLoop::ConnectionStats stats;
+    for (size_t i = 0; i < loop_list_.size(); i++) {
+        loop_list_[i]->AddConnectionStats(stats);
+    }
 
-    setsock(fdp, sock, easy, action, 0);
-    curl_multi_assign(http_manager_->curl_m_, sock, fdp);
+    return stats;
 }
-void HttpManager::setsock(int *fdp, 
-                          curl_socket_t sock, 
-                          CURL* easy, 
-                          int act, 
-                          int oldact) {
-    auto iter = http_manager_->socket_list_.find(sock);
-    if(iter == http_manager_->socket_list_.end()) {
-        return;
+
+HttpLoop::HOST_STATS_LIST HttpManager::host_stats() const {
+    HttpLoop::HOST_STATS_LIST stats_list;
+    for (size_t i = 0; i < loop_list_.size(); i++) {
+        loop_list_[i]->AddHostStats(stats_list);
     }
 
-    boost::asio::ip::tcp::socket* tcp_socket = iter->second;
-    *fdp = act;
+    return stats_list;
+}
 
-    if(act == CURL_POLL_IN) {
-        if(oldact != CURL_POLL_IN && oldact != CURL_POLL_INOUT) {
-            tcp_socket->async_read_some(boost::asio::null_buffers(),
-                                        boost::bind(&event_cb, sock,
-                                                    CURL_POLL_IN, _1, fdp));
-        }
-    } else if(act == CURL_POLL_OUT) {
-        if(oldact != CURL_POLL_OUT && oldact != CURL_POLL_INOUT) {
-            tcp_socket->async_write_some(boost::asio::null_buffers(),
-                                         boost::bind(&event_cb, sock,
-                                                     CURL_POLL_OUT, _1, fdp));
-        }
-    } else if(act == CURL_POLL_INOUT) {
-        if(oldact != CURL_POLL_IN && oldact != CURL_POLL_INOUT) {
-            tcp_socket->async_read_some(boost::asio::null_buffers(),
-                                        boost::bind(&event_cb, sock,
-                                                    CURL_POLL_IN, _1, fdp));
-        }
-        if(oldact != CURL_POLL_OUT && oldact != CURL_POLL_INOUT) {
-            tcp_socket->async_write_some(boost::asio::null_buffers(),
-                                         boost::bind(&event_cb, sock,
-                                                     CURL_POLL_OUT, _1, fdp));
-        }
-    }
+void HttpManager::AddHttpRequest(std::shared_ptr<HttpRequest> request) {
+    HttpLoop* loop = SelectLoop(request);
+    loop->thread()->PostTask(std::bind(&HttpLoop::AddHttpRequestInThread, loop, 
+                                       std::move(request)));
 
     return;
 }
-void HttpManager::remsock(int* fdp) {
-    if(fdp) {
-        free(fdp);
+void HttpManager::CancelHttpRequest(std::shared_ptr<HttpRequest> request) {
+    // Drops the request at once if it is still queued, 
+    // and its delegate call if it is about to complete.
+    if (request == NULL) {
+        return;
+    }
+    request->cancellation_token().Cancel();
+    HttpLoop* loop = request->loop_;
+    if (loop == NULL) {
+        return;
     }
+    loop->thread()->PostTask(std::bind(&HttpLoop::CancelHttpRequestInThread, loop, 
+                                       std::move(request)));
 
     return;
 }
-void HttpManager::event_cb(curl_socket_t sock, 
-                           int action, 
-                           const boost::system::error_code& error, 
-                           int *fdp) {
-    auto iter = http_manager_->socket_list_.find(sock);
-    if(iter == http_manager_->socket_list_.end()) {
+void HttpManager::PauseHttpRequest(std::shared_ptr<HttpRequest> request) {
+    if (request == NULL) {
         return;
     }
-
-    // make sure the event matches what are wanted 
-    if(*fdp == action || *fdp == CURL_POLL_INOUT) {
-        if(error) {
-            action = CURL_CSELECT_ERR;
-        }
-        curl_multi_socket_action(http_manager_->curl_m_, sock, 
-                                 action, &http_manager_->still_running_);
-
-        check_multi_info();
-
-        /* keep on watching.
-            * the socket may have been closed and/or fdp may have been changed
-            * in curl_multi_socket_action(), so check them both */
-        if(!error && (*fdp == action || *fdp == CURL_POLL_INOUT)) {
-            boost::asio::ip::tcp::socket* tcp_socket = iter->second;
-            if(action == CURL_POLL_IN) {
-                tcp_socket->async_read_some(boost::asio::null_buffers(),
-                                            boost::bind(&event_cb, sock,
-                                                        action, _1, fdp));
-            }
-            if(action == CURL_POLL_OUT) {
-                tcp_socket->async_write_some(boost::asio::null_buffers(),
-                                             boost::bind(&event_cb, sock,
-                                                         action, _1, fdp));
-            }
-        }
-    } 
+    HttpLoop* loop = request->loop_;
+    if (loop == NULL) {
+        return;
+    }
+    loop->thread()->PostTask(std::bind(&HttpLoop::PauseHttpRequestInThread, loop, 
+                                       std::move(request)));
 
     return;
 }
-
-curl_socket_t HttpManager::opensocket(void* clientp, 
-                                      curlsocktype purpose, 
-                                      struct curl_sockaddr* address) {
-    curl_socket_t sockfd = CURL_SOCKET_BAD;
-
-    // restrict to IPv4
-    if(purpose == CURLSOCKTYPE_IPCXN && address->family == AF_INET) {
-        // create a tcp socket object 
-        boost::asio::ip::tcp::socket* tcp_socket =
-            new boost::asio::ip::tcp::socket(http_manager_->thread_->io_service());
-
-        // open it and get the native handle
-        boost::system::error_code code;
-        tcp_socket->open(boost::asio::ip::tcp::v4(), code);
-
-        if(!code) {
-            sockfd = tcp_socket->native_handle();
-
-            // save it for monitoring 
-            http_manager_->socket_list_[sockfd] = tcp_socket;
-        }
+void HttpManager::ResumeHttpRequest(std::shared_ptr<HttpRequest> request) {
+    if (request == NULL) {
+        return;
     }
-
-    return sockfd;
-}
-int HttpManager::close_socket(void* clientp, 
-                              curl_socket_t sock) {
-    auto iter = http_manager_->socket_list_.find(sock);
-    if(iter != http_manager_->socket_list_.end()) {
-        delete iter->second;
-        http_manager_->socket_list_.erase(iter);
+    HttpLoop* loop = request->loop_;
+    if (loop == NULL) {
+        return;
     }
+    loop->thread()->PostTask(std::bind(&HttpLoop::ResumeHttpRequestInThread, loop, 
+                                       std::move(request)));
 
-    return 0;
+    return;
 }
+bool HttpManager::TryAddHttpRequest(std::shared_ptr<HttpRequest> request) {
+    HttpLoop* loop = SelectLoop(request);
 
-size_t HttpManager::write_cb(void* buffer, 
-                             size_t size, 
-                             size_t count, 
-                             void* stream) {
-    CURL* curl = static_cast<CURL*>(stream);
+    return loop->thread()->TryPostTask(std::bind(&HttpLoop::AddHttpRequestInThread, loop, 
+                                                 std::move(request)));
+}
 
-    auto iter = http_manager_->callback_data_list_.find(curl);
-    if (iter == http_manager_->callback_data_list_.end()) {
-        return 0;
+HttpLoop* HttpManager::SelectLoop(const std::shared_ptr<HttpRequest>& request) {
+    size_t index = 0;
+    if (loop_list_.size() == 1) {
+        index = 0;
+    } else if (distribution_ == HOST_HASH && request != NULL) {
+        index = std::hash<std::string>()(request->host()) % loop_list_.size();
+    } else {
+        index = next_loop_++ % loop_list_.size();
+    }
+    if (request != NULL) {
+        request->loop_ = loop_list_[index].get();
     }
 
-    iter->second.buffer.append((char*)buffer, size*count);
-
-    return size * count;
+    return loop_list_[index].get();
 }
 
-void HttpManager::check_multi_info() {
-    CURLMsg *msg;
-    int msgs_left = 0;
-    while((msg = curl_multi_info_read(http_manager_->curl_m_, &msgs_left))) {
-        if(msg->msg == CURLMSG_DONE) {
-            http_manager_->HttpRequestComplete(msg);
-        }
-    }
+void HttpManager::lock_cb(CURL* handle, 
+                          curl_lock_data data, 
+                          curl_lock_access access, 
+                          void* userp) {
+    static_cast<HttpManager*>(userp)->share_mutex_list_[data].lock();
+
+    return;
+}
+void HttpManager::unlock_cb(CURL* handle, 
+                            curl_lock_data data, 
+                            void* userp) {
+    static_cast<HttpManager*>(userp)->share_mutex_list_[data].unlock();
 
     return;
 }
@@ -19,107 +19,119 @@
 #pragma once 
 
 #include <string>
-#include <map>
-#include <curl/curl.h>
+#include <vector>
+#include <atomic>
+#include <memory>
 #include <async/async.h>
 #include <boost/thread/mutex.hpp>
+#include <http/http_loop.h>
 
 namespace http {
 
 class HttpRequest;
 
 // Http task scheduling class
+// Requests run on loop_num event loops, each with its own thread
+// and multi handle, a request stays on the loop it was given to.
 class HttpManager {
 public:
-    // Callback data when the request is completed
-    struct CallbackData {
-        CallbackData() {}
-        ~CallbackData() {}
-
-        std::string buffer;
-        std::shared_ptr<http::HttpRequest> request;
+    // How requests are spread over the loops.
+    enum Distribution {
+        ROUND_ROBIN = 0, // Each request to the next loop.
+        HOST_HASH,       // Requests to one host share a loop and its connections.
     };
 
-    // Request data to be used
-    struct CURLData {
-        CURLData() : curl_(NULL)
-                   , headers_(NULL) {}
-        ~CURLData() {
-            if (curl_ != NULL) {
-                curl_easy_cleanup(curl_);
-                curl_ = NULL;
-            }
-
-            if (headers_ != NULL) {
-                curl_slist_free_all(headers_);
-                headers_ = NULL;
-            }
-        }
-
-        CURL* curl_;
-        struct curl_slist* headers_;
-        std::string post_data_;
-    };
-
-    typedef std::map<std::shared_ptr<HttpRequest>, std::unique_ptr<CURLData>> REQUEST_LIST;
-    typedef std::map<CURL*, CallbackData> CB_DATA_LIST;
-    typedef std::map<curl_socket_t, boost::asio::ip::tcp::socket*> SOCKET_LIST;
-
     static HttpManager* GetInstance();
 
+    // Pin the loop threads, call before Start.
+    // Loop i runs on cpu_list[i % size] when a cpu list is set.
+    void set_placement(const async::Thread::Placement& placement);
+    // Bound the requests queued for each loop thread, call before Start.
+    // AddHttpRequest waits for room, TryAddHttpRequest fails.
+    void set_queue_capacity(size_t queue_capacity);
+    // Share the DNS cache and TLS sessions of all loops, default true,
+    // call before Start. Each loop reuses its connections and easy
+    // handles either way.
+    void set_connection_sharing(bool connection_sharing);
+    // Collect the metrics of the loop threads, default false,
+    // call before Start. It costs three clock reads per task.
+    void set_enable_metrics(bool enable_metrics);
+    // Use http/2 and multiplex requests to one origin on a connection,
+    // default HTTP1_1, call before Start.
+    void set_http_version(HttpLoop::HttpVersion http_version);
+    // Limits of HttpLoop::Settings, call before Start.
+    void set_max_host_connections(int max_host_connections);
+    void set_max_connection_streams(int max_connection_streams);
+    // In-flight limits, 0 for no limit, call before Start.
+    // max_requests is split evenly over the loops. A host has one 
+    // loop with HOST_HASH, with ROUND_ROBIN max_host_requests 
+    // holds per loop.
+    void set_max_requests(int max_requests);
+    void set_max_host_requests(int max_host_requests);
+    // Number of event loops, default 1, call before Start.
+    void set_loop_num(int loop_num);
+    void set_distribution(Distribution distribution);
     void Start();
-
-    void AddHttpRequest(const std::shared_ptr<HttpRequest>& request);
-    void CancelHttpRequest(const std::shared_ptr<HttpRequest>& request);
+    // Stops and joins the loops, running and queued requests are dropped
+    // without their delegate call. Call after the last request was added,
+    // requests added before may not be paused, resumed or cancelled after.
+    // Start can be called again.
+    void Stop();
+
+    int loop_num() const;
+    // Metrics of a loop thread, empty before Start.
+    // Queue depth and dropped tasks only without set_enable_metrics.
+    async::Thread::Metrics thread_metrics(int loop_index = 0) const;
+    // Summed over the loops, with the connections and streams in use.
+    HttpLoop::ConnectionStats connection_stats() const;
+    // Queue time per host, only for requests under in-flight limits.
+    // A loop keeps the stats of its 256 most recently idle hosts.
+    HttpLoop::HOST_STATS_LIST host_stats() const;
+
+    // Add, cancel, pause and resume are always posted to the loop 
+    // thread, never run inline: called from a delegate they would 
+    // reenter curl from inside its own callback.
+    void AddHttpRequest(std::shared_ptr<HttpRequest> request);
+    // Cancels the token of the request, the request and its delegate 
+    // call are dropped even when the cancel is still queued.
+    // A request waiting for an in-flight limit is dropped at its turn.
+    // The token stays cancelled, give the request a new one before
+    // adding it again.
+    void CancelHttpRequest(std::shared_ptr<HttpRequest> request);
+    // Pause or resume the body of a streaming request, from any thread.
+    void PauseHttpRequest(std::shared_ptr<HttpRequest> request);
+    void ResumeHttpRequest(std::shared_ptr<HttpRequest> request);
+    // Returns false when the queue is full, the request is not added.
+    bool TryAddHttpRequest(std::shared_ptr<HttpRequest> request);
 
 private:
     HttpManager();
     ~HttpManager();
 
-    void HttpRequestComplete(CURLMsg* msg);
-    CURLData* CreateCURLData(const std::shared_ptr<HttpRequest>& request);
+    HttpLoop* SelectLoop(const std::shared_ptr<HttpRequest>& request);
 
-    static int multi_timer_cb(CURLM* multi, 
-                              long timeout_ms);
-    static void timer_cb();
-    static int sock_cb(CURL* easy, 
-                       curl_socket_t sock, 
-                       int what, 
-                       void* cbp, 
-                       void* sockp);
-    static void addsock(curl_socket_t sock, 
-                        CURL* easy, 
-                        int action);
-    static void setsock(int* fdp, 
-                        curl_socket_t sock, 
-                        CURL* easy, 
-                        int act, 
-                        int oldact);
-    static void remsock(int* fdp);
-    static void event_cb(curl_socket_t s, 
-                         int action, 
-                         const boost::system::error_code& error, 
-                         int* fdp);
-    static curl_socket_t opensocket(void* clientp, 
-                                    curlsocktype purpose, 
-                                    struct curl_sockaddr* address);
-    static int close_socket(void* clientp, 
-                            curl_socket_t sock);
-    static size_t write_cb(void* buffer, 
-                           size_t size, 
-                           size_t count, 
-                           void* stream);
-    static void check_multi_info();
+    static void lock_cb(CURL* handle, 
+                        curl_lock_data data, 
+                        curl_lock_access access, 
+                        void* userp);
+    static void unlock_cb(CURL* handle, 
+                          curl_lock_data data, 
+                          void* userp);
 
 private:
     bool is_running_;
-    int still_running_;
-    CURLM* curl_m_;
-    async::Timer timer_; 
-    std::shared_ptr<async::Thread> thread_;
-    REQUEST_LIST request_list_;
-    CB_DATA_LIST callback_data_list_;
-    SOCKET_LIST socket_list_;
+    async::Thread::Placement placement_;
+    size_t queue_capacity_;
+    int loop_num_;
+    HttpLoop::Settings settings_;
+    Distribution distribution_;
+    std::atomic<size_t> next_loop_;
+    std::vector<std::unique_ptr<HttpLoop>> loop_list_;
+    bool connection_sharing_;
+    bool enable_metrics_;
+    CURLSH* share_;
+    // One lock per kind of shared data.
+    boost::mutex share_mutex_list_[CURL_LOCK_DATA_LAST];
 
     static HttpManager* http_manager_;
 };
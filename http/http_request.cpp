@@ -26,9 +26,12 @@ HttpRequest::HttpRequest(HttpMode http_mode,
                          const std::string& url,
                          Delegate* delegate)
             : status_(INIT)
+            , priority_(NORMAL)
             , http_mode_(http_mode)
             , url_(url)
-            , delegate_(delegate) {
+            , delegate_(delegate)
+            , stream_delegate_(NULL)
+            , loop_(NULL) {
 
 }
 HttpRequest::~HttpRequest() {
@@ -55,6 +58,13 @@ const std::string& HttpRequest::url() {
 void HttpRequest::set_url(const std::string& url) {
     url_ = url;
 }
+std::string HttpRequest::host() {
+    size_t begin = url_.find("://");
+    begin = begin == std::string::npos ? 0 : begin + 3;
+    size_t end = url_.find_first_of("/?#", begin);
+
+    return url_.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
 
 const std::map<std::string, std::string>& HttpRequest::params() {
     return params_;
@@ -69,6 +79,15 @@ HttpRequest::Delegate* HttpRequest::delegate() {
 }
 void HttpRequest::set_delegate(Delegate* delegate) {
     delegate_ = delegate; 
+    stream_delegate_ = NULL;
+}
+
+HttpRequest::StreamDelegate* HttpRequest::stream_delegate() {
+    return stream_delegate_;
+}
+void HttpRequest::set_stream_delegate(StreamDelegate* stream_delegate) {
+    stream_delegate_ = stream_delegate;
+    delegate_ = stream_delegate;
 }
 
 const std::string& HttpRequest::cookie() {
@@ -85,11 +104,28 @@ void HttpRequest::set_status(Status status) {
     status_ = status;
 }
 
+HttpRequest::Priority HttpRequest::priority() {
+    return priority_;
+}
+void HttpRequest::set_priority(Priority priority) {
+    priority_ = priority;
+}
+
 const std::string& HttpRequest::response() {
     return response_;
 }
 void HttpRequest::set_response(const std::string& response) {
     response_ = response;
 }
+void HttpRequest::set_response(std::string&& response) {
+    response_ = std::move(response);
+}
+
+async::CancellationToken HttpRequest::cancellation_token() {
+    return cancellation_token_;
+}
+void HttpRequest::set_cancellation_token(const async::CancellationToken& cancellation_token) {
+    cancellation_token_ = cancellation_token;
+}
 
 } // namespace http
\ No newline at end of file
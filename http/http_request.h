@@ -21,10 +21,15 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <atomic>
 #include <memory>
+#include <async/cancellation.h>
 
 namespace http {
 
+class HttpLoop;
+class HttpManager;
+
 // Http request class.
 // Use this class to set the request type, request parameters, 
 // request callbacks, and get the result of the request.
@@ -38,12 +43,35 @@ public:
         virtual void OnHttpRequestComplete(std::shared_ptr<HttpRequest> request) = 0;
     };
 
+    // Request a streaming callback class.
+    // The body is handed over in chunks as it arrives instead of 
+    // being kept in response, OnHttpRequestComplete still ends it.
+    class StreamDelegate : public Delegate {
+    public:
+        // Called on the http thread for each chunk of the body. 
+        // Returns false to pause the transfer, the same chunk is 
+        // delivered again after HttpManager::ResumeHttpRequest.
+        // HttpManager add, cancel, pause and resume are safe to call
+        // from here, they run after the callback returns.
+        virtual bool OnHttpRequestData(std::shared_ptr<HttpRequest> request,
+                                       const char* data,
+                                       size_t size) = 0;
+    };
+
     // Http request type get or post.
     enum HttpMode {
         GET = 0,
         POST,
     };
 
+    // Order of the requests waiting for an in-flight limit,
+    // a host with no waiting HIGH request waits for the others.
+    enum Priority {
+        HIGH = 0,
+        NORMAL,
+        LOW,
+    };
+
     // Http request status.
     enum Status {
         INIT = 0, // Initialization state
@@ -64,13 +92,19 @@ public:
     
     const std::string& url();
     void set_url(const std::string& url);
+    // The part of the url between the scheme and the path.
+    std::string host();
 
     const std::map<std::string, std::string>& params();
     void add_params(const std::string& key,
                     const std::string& value);
 
     Delegate* delegate();
+    // Turns streaming off.
     void set_delegate(Delegate* delegate);
+    // NULL unless the request streams, sets the delegate too.
+    StreamDelegate* stream_delegate();
+    void set_stream_delegate(StreamDelegate* stream_delegate);
 
     const std::string& cookie();
     void set_cookie(const std::string& cookie);
@@ -78,18 +112,37 @@ public:
     Status status();
     void set_status(Status status);
 
+    Priority priority();
+    void set_priority(Priority priority);
+
     const std::string& response();
     void set_response(const std::string& response);
+    void set_response(std::string&& response);
+
+    // Cancelled by HttpManager::CancelHttpRequest. Requests may share
+    // a token, cancelling it drops them all before the delegate runs.
+    // Post follow-up work with it to drop that too.
+    // A cancelled token stays cancelled, set a new one to reuse 
+    // the request.
+    async::CancellationToken cancellation_token();
+    void set_cancellation_token(const async::CancellationToken& cancellation_token);
 
 private:
     int http_code_;
     Status status_;
+    Priority priority_;
     HttpMode http_mode_;
     std::string url_;
     std::string cookie_;
     std::string response_;
     Delegate* delegate_;
+    StreamDelegate* stream_delegate_;
+    // The loop running the request, set when it is added.
+    std::atomic<HttpLoop*> loop_;
+    async::CancellationToken cancellation_token_;
     std::map<std::string, std::string> params_;
+
+    friend class HttpManager;
 };
 
 }; // namespace http
\ No newline at end of file
@@ -46,9 +46,15 @@ void AsyncRpcServerImpl::Join() {
     }
 }
 
-void AsyncRpcServerImpl::Init(int thread_num) {
+void AsyncRpcServerImpl::Init(int thread_num, const async::Thread::Placement& placement) {
+    async::Thread::Options options;
+    options.thread_num = thread_num;
+    options.placement = placement;
+    Init(options);
+}
+void AsyncRpcServerImpl::Init(const async::Thread::Options& options) {
     if (thread_.get() == NULL) {
-        thread_.reset(new async::Thread(thread_num));
+        thread_.reset(new async::Thread(options));
     }
 }
 
@@ -65,6 +71,14 @@ void AsyncRpcServerImpl::Run(const std::string& host, int port) {
     thread_->PostTask(boost::bind(&AsyncRpcServerImpl::HandleRpcs, this));
 }
 
+async::Thread::Metrics AsyncRpcServerImpl::thread_metrics() const {
+    if (thread_.get() == NULL) {
+        return async::Thread::Metrics();
+    }
+
+    return thread_->metrics();
+}
+
 void AsyncRpcServerImpl::AddInitCallData(CallData* call_data) {
     init_call_data_list_.push_back(call_data);
 }
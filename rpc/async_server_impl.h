@@ -47,10 +47,18 @@ public:
     static AsyncRpcServerImpl* GetInstance();
     
     void Join();
-    void Init(int thread_num);
+    // The placement pins the rpc message threads.
+    void Init(int thread_num, 
+              const async::Thread::Placement& placement = async::Thread::Placement());
+    // A bounded pool lets handlers shed load with thread_->TryPostTask.
+    // Set options.enable_metrics to collect the full thread_metrics.
+    void Init(const async::Thread::Options& options);
     void Run(const std::string& host, int port) override;
     void AddInitCallData(CallData* call_data);
 
+    // Metrics of the rpc message threads, empty before Init.
+    async::Thread::Metrics thread_metrics() const;
+
     grpc::ServerCompletionQueue* cq();
 
 private:
@@ -0,0 +1,116 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <async/async.h>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
+// Messages to many single-owner objects from several producers:
+// a PostTask per message with a mutex per object, against actors.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kObjectNum = 100;
+const int kProducerNum = 4;
+const int kMessageNum = 250000;
+
+struct Counter {
+    Counter() : value(0) {}
+
+    boost::mutex mutex;
+    int64_t value;
+};
+
+std::atomic<int> done_num(0);
+
+void AddLocked(Counter* counter) {
+    counter->mutex.lock();
+    counter->value++;
+    counter->mutex.unlock();
+    done_num++;
+}
+
+void Add(Counter* counter) {
+    counter->value++;
+    done_num++;
+}
+
+void ProduceLocked(async::Thread* thread, std::vector<Counter>* counter_list, int seed) {
+    for (int i = 0; i < kMessageNum; i++) {
+        thread->PostTask(boost::bind(&AddLocked, &(*counter_list)[(seed + i * 7) % kObjectNum]));
+    }
+}
+
+void Produce(std::vector<std::unique_ptr<async::Actor>>* actor_list, 
+             std::vector<Counter>* counter_list, int seed) {
+    for (int i = 0; i < kMessageNum; i++) {
+        int object = (seed + i * 7) % kObjectNum;
+        (*actor_list)[object]->Post(boost::bind(&Add, &(*counter_list)[object]));
+    }
+}
+
+void Wait(const char* name, Clock::time_point start) {
+    while (done_num < kProducerNum * kMessageNum) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    printf("%-24s %12.0f messages/s\n", name, kProducerNum * kMessageNum / elapsed.count());
+}
+
+int main() {
+    std::shared_ptr<async::Thread> thread(new async::Thread(4));
+
+    std::vector<Counter> counter_list(kObjectNum);
+    done_num = 0;
+    Clock::time_point start = Clock::now();
+    boost::thread_group producer_list;
+    for (int i = 0; i < kProducerNum; i++) {
+        producer_list.create_thread(boost::bind(&ProduceLocked, thread.get(), &counter_list, i));
+    }
+    producer_list.join_all();
+    Wait("PostTask + mutex", start);
+
+    std::vector<Counter> actor_counter_list(kObjectNum);
+    std::vector<std::unique_ptr<async::Actor>> actor_list;
+    for (int i = 0; i < kObjectNum; i++) {
+        actor_list.push_back(std::unique_ptr<async::Actor>(new async::Actor(thread)));
+    }
+    done_num = 0;
+    start = Clock::now();
+    boost::thread_group actor_producer_list;
+    for (int i = 0; i < kProducerNum; i++) {
+        actor_producer_list.create_thread(boost::bind(&Produce, &actor_list, 
+                                                      &actor_counter_list, i));
+    }
+    actor_producer_list.join_all();
+    Wait("Actor", start);
+
+    int64_t total = 0;
+    for (int i = 0; i < kObjectNum; i++) {
+        total += actor_counter_list[i].value;
+    }
+    printf("actor messages run %lld\n", (long long)total);
+
+    thread->Stop();
+    thread->Join();
+
+    return 0;
+}
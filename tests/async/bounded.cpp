@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+std::atomic<int> run_num(0);
+
+void Slow() {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    run_num++;
+}
+
+void Run(const char* name, async::Thread::Overflow overflow) {
+    async::Thread::Options options;
+    options.capacity = 4;
+    options.overflow = overflow;
+    async::Thread thread(options);
+
+    run_num = 0;
+    int try_failed = 0;
+    for (int i = 0; i < 20; i++) {
+        if (!thread.TryPostTask(&Slow)) {
+            try_failed++;
+        }
+    }
+    // BLOCK waits here until the worker makes room.
+    int post_failed = 0;
+    for (int i = 0; i < 20; i++) {
+        if (!thread.PostTask(&Slow)) {
+            post_failed++;
+        }
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(400));
+
+    async::Thread::Metrics metrics = thread.metrics();
+    std::cout << name << " try failed:" << try_failed << " post failed:" << post_failed 
+              << " run:" << run_num 
+              << " rejected:" << metrics.rejected_num 
+              << " dropped:" << metrics.dropped_num << std::endl;
+
+    thread.Stop();
+    thread.Join();
+}
+
+int Answer() {
+    return 42;
+}
+
+void CountMessage(std::atomic<int>* message_num) {
+    (*message_num)++;
+}
+
+// Actor messages and future tasks go over the capacity, 
+// a full pool runs them instead of losing them.
+void RunLibrary(const char* name, async::Thread::Overflow overflow) {
+    async::Thread::Options options;
+    options.capacity = 4;
+    options.overflow = overflow;
+    std::shared_ptr<async::Thread> thread(new async::Thread(options));
+
+    for (int i = 0; i < 4; i++) {
+        thread->PostTask(&Slow);
+    }
+
+    std::atomic<int> message_num(0);
+    async::Actor actor(thread);
+    for (int i = 0; i < 10; i++) {
+        actor.Post(boost::bind(&CountMessage, &message_num));
+    }
+    async::Future<int> future = thread->PostTaskWithResult(&Answer);
+    // Full of pinned and slow tasks, only a slow one may go.
+    bool posted = thread->PostTask(&Slow);
+
+    int value = future.Get();
+    for (int i = 0; i < 100 && message_num < 10; i++) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    std::cout << name << " full pool, post:" << posted << " actor messages:" << message_num 
+              << " future:" << value << std::endl;
+
+    thread->Stop();
+    thread->Join();
+}
+
+int main() {
+    Run("block", async::Thread::BLOCK);
+    Run("reject", async::Thread::REJECT);
+    Run("drop oldest", async::Thread::DROP_OLDEST);
+    RunLibrary("reject", async::Thread::REJECT);
+    RunLibrary("drop oldest", async::Thread::DROP_OLDEST);
+
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <iostream>
+#include <atomic>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+std::atomic<int> run_num(0);
+
+void Hold(const std::shared_ptr<int>& value) {
+    run_num += *value;
+}
+
+void Slow() {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    run_num++;
+}
+
+int main() {
+    std::shared_ptr<async::Thread> thread(new async::Thread(1));
+    async::CancellationToken token;
+
+    // The first task is running when the token is cancelled,
+    // the queued ones are dropped.
+    for (int i = 0; i < 10; i++) {
+        thread->PostTask(&Slow, token);
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+    token.Cancel();
+
+    async::Timer timer;
+    async::CancellationToken timer_token;
+    timer.CreateOnceTimerTask(&Slow, boost::posix_time::milliseconds(20), 
+                              thread, timer_token);
+    timer_token.Cancel();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+
+    // Cancel releases the closure of a far timer at once.
+    std::shared_ptr<int> value(new int(100));
+    std::weak_ptr<int> weak_value = value;
+    async::CancellationToken far_token;
+    timer.CreateOnceTimerTask(boost::bind(&Hold, value), boost::posix_time::seconds(3600), 
+                              thread, far_token);
+    value.reset();
+    bool held = !weak_value.expired();
+    far_token.Cancel();
+
+    std::cout << "run:" << run_num 
+              << " cancelled:" << thread->metrics().cancelled_num 
+              << " held:" << held << " released:" << weak_value.expired() << std::endl;
+
+    thread->Stop();
+    thread->Join();
+
+    return 0;
+}
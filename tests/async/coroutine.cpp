@@ -0,0 +1,62 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <async/async.h>
+#include <async/coroutine.h>
+
+async::Timer timer;
+std::shared_ptr<async::Thread> work_thread;
+std::shared_ptr<async::Thread> main_thread;
+
+async::CoTask<int> Square(int a) {
+    // Continue on the work thread
+    co_await work_thread->Schedule();
+    co_return a * a;
+}
+
+async::CoTask<int> Handle() {
+    int sum = 0;
+    for (int i = 1; i <= 3; i++) {
+        // Square resumes us back on the main thread
+        sum += co_await Square(i);
+        // Sleep 100 millisecond
+        co_await timer.Sleep(boost::posix_time::millisec(100));
+        std::cout << "step:" << i << " on main thread:" 
+                  << (async::Thread::Current() == main_thread.get()) << std::endl;
+    }
+
+    co_return sum;
+}
+
+int main() {
+    // Init threads
+    work_thread.reset(new async::Thread(2));
+    main_thread.reset(new async::Thread());
+
+    // Start the coroutine on the main thread and wait for its result
+    int sum = async::Spawn(main_thread.get(), Handle()).Get();
+    std::cout << "sum:" << sum << std::endl;
+
+    work_thread->Stop();
+    main_thread->Stop();
+    work_thread->Join();
+    main_thread->Join();
+
+    return 0;
+}
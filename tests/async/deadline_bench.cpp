@@ -0,0 +1,92 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// An overloaded pool: requests that must start within 20ms arrive faster
+// than they are served. Plain tasks all run, most of them too late,
+// deadline tasks fail fast once late and leave the time to the rest.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kRequestNum = 2000;
+const int kTimeoutMs = 20;
+
+struct Stats {
+    Stats() : on_time_num(0), late_num(0), failed_num(0) {}
+
+    std::atomic<int> on_time_num;
+    std::atomic<int> late_num;
+    std::atomic<int> failed_num;
+};
+
+void Serve(Clock::time_point post_time, Stats* stats) {
+    if (Clock::now() - post_time > std::chrono::milliseconds(kTimeoutMs)) {
+        stats->late_num++;
+    } else {
+        stats->on_time_num++;
+    }
+    // The work of a request.
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(100);
+    while (Clock::now() < end) {
+    }
+}
+
+void Fail(Stats* stats) {
+    stats->failed_num++;
+}
+
+void Run(const char* name, bool deadline) {
+    async::Thread thread(1);
+    Stats stats;
+
+    Clock::time_point begin = Clock::now();
+    for (int i = 0; i < kRequestNum; i++) {
+        if (deadline) {
+            thread.PostTaskWithDeadline(boost::bind(&Serve, Clock::now(), &stats),
+                                        boost::posix_time::milliseconds(kTimeoutMs),
+                                        boost::bind(&Fail, &stats));
+        } else {
+            thread.PostTask(boost::bind(&Serve, Clock::now(), &stats));
+        }
+        // Requests arrive every 50us, twice as fast as they are served.
+        Clock::time_point next = begin + std::chrono::microseconds(50 * (i + 1));
+        while (Clock::now() < next) {
+        }
+    }
+
+    thread.Stop();
+    thread.Join();
+
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - begin;
+    printf("%-10s on time %5d  late %5d  failed fast %5d  %8.1fms\n", name,
+           stats.on_time_num.load(), stats.late_num.load(), stats.failed_num.load(),
+           elapsed.count());
+}
+
+int main() {
+    Run("plain", false);
+    Run("deadline", true);
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Cost of the current thread check on a 64 worker pool, 
+// and of a task chain on the pool with Dispatch against PostTask.
+// Dispatch has no recursion guard, so the Dispatch chain still posts 
+// 1 hop in kPostInterval to keep the stack flat, the PostTask chain 
+// posts every hop. Both chains have the same number of hops.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kCheckNum = 1000000;
+const int kChainNum = 1000000;
+const int kPostInterval = 64;
+
+std::atomic<bool> done(false);
+
+void Check(async::Thread* thread) {
+    Clock::time_point start = Clock::now();
+    int hit = 0;
+    for (int i = 0; i < kCheckNum; i++) {
+        if (*thread == CURRENT_THREAD) {
+            hit++;
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+    printf("%-24s %8.1fns  (%d)\n", "operator== on a worker", elapsed.count() / kCheckNum, hit);
+
+    start = Clock::now();
+    for (int i = 0; i < kCheckNum; i++) {
+        if (thread->RunsTasksInCurrentThread()) {
+            hit++;
+        }
+    }
+    elapsed = Clock::now() - start;
+    printf("%-24s %8.1fns  (%d)\n", "RunsTasksInCurrentThread", elapsed.count() / kCheckNum, hit);
+
+    done = true;
+}
+
+void Chain(async::Thread* thread, int left, bool dispatch, Clock::time_point start) {
+    if (left == 0) {
+        std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+        if (dispatch) {
+            printf("%-24s %8.1fns per hop  (1/%d hops posted)\n", "Dispatch chain", 
+                   elapsed.count() / kChainNum, kPostInterval);
+        } else {
+            printf("%-24s %8.1fns per hop  (every hop posted)\n", "PostTask chain", 
+                   elapsed.count() / kChainNum);
+        }
+        done = true;
+        return;
+    }
+
+    if (dispatch && left % kPostInterval != 0) {
+        thread->Dispatch(boost::bind(&Chain, thread, left - 1, dispatch, start));
+    } else {
+        thread->PostTask(boost::bind(&Chain, thread, left - 1, dispatch, start));
+    }
+}
+
+void WaitDone() {
+    while (!done) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    done = false;
+}
+
+int main() {
+    async::Thread thread(64);
+
+    thread.PostTask(boost::bind(&Check, &thread));
+    WaitDone();
+
+    thread.PostTask(boost::bind(&Chain, &thread, kChainNum, false, Clock::now()));
+    WaitDone();
+    thread.PostTask(boost::bind(&Chain, &thread, kChainNum, true, Clock::now()));
+    WaitDone();
+
+    thread.Stop();
+    thread.Join();
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <async/async.h>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+// Socket echo round trips served by a pool's io_service.
+// Build once with ASYNC_IO_URING and ASYNC_IO_URING_REACTOR and once 
+// without to compare the io_uring and epoll event loops. ASYNC_IO_URING
+// alone keeps sockets on epoll.
+
+const int kClientNum = 16;
+const int kMessageSize = 64;
+const int kRunSeconds = 2;
+
+std::atomic<bool> running(true);
+std::atomic<uint64_t> round_trip_num(0);
+
+class Session : public boost::enable_shared_from_this<Session> {
+public:
+    Session(boost::asio::io_service& io_service) : socket_(io_service) {}
+
+    void Read() {
+        socket_.async_read_some(boost::asio::buffer(data_), 
+                                boost::bind(&Session::OnRead, shared_from_this(), _1, _2));
+    }
+
+    void OnRead(const boost::system::error_code& err, size_t size) {
+        if (err) {
+            return;
+        }
+        boost::asio::async_write(socket_, boost::asio::buffer(data_, size), 
+                                 boost::bind(&Session::OnWrite, shared_from_this(), _1));
+    }
+
+    void OnWrite(const boost::system::error_code& err) {
+        if (!err) {
+            Read();
+        }
+    }
+
+    boost::asio::ip::tcp::socket socket_;
+    char data_[kMessageSize];
+};
+
+void Accept(async::Thread* thread, boost::asio::ip::tcp::acceptor* acceptor);
+
+void OnAccept(async::Thread* thread, boost::asio::ip::tcp::acceptor* acceptor, 
+              boost::shared_ptr<Session> session, const boost::system::error_code& err) {
+    if (!err) {
+        session->socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+        session->Read();
+    }
+    Accept(thread, acceptor);
+}
+
+void Accept(async::Thread* thread, boost::asio::ip::tcp::acceptor* acceptor) {
+    boost::shared_ptr<Session> session(new Session(thread->io_service()));
+    acceptor->async_accept(session->socket_, boost::bind(&OnAccept, thread, acceptor, session, _1));
+}
+
+void Client(unsigned short port) {
+    boost::asio::io_service io_service;
+    boost::asio::ip::tcp::socket socket(io_service);
+    socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+    socket.set_option(boost::asio::ip::tcp::no_delay(true));
+
+    char data[kMessageSize] = { 0 };
+    while (running) {
+        boost::asio::write(socket, boost::asio::buffer(data));
+        boost::asio::read(socket, boost::asio::buffer(data));
+        round_trip_num++;
+    }
+}
+
+int main() {
+    printf("event loop %s, io_uring supported by kernel: %s\n", async::Thread::EventBackend(), 
+           async::Thread::IoUringSupported() ? "yes" : "no");
+
+    async::Thread thread(2);
+    boost::asio::ip::tcp::acceptor acceptor(thread.io_service(), 
+        boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    Accept(&thread, &acceptor);
+
+    boost::thread_group client_list;
+    for (int i = 0; i < kClientNum; i++) {
+        client_list.create_thread(boost::bind(&Client, acceptor.local_endpoint().port()));
+    }
+    boost::this_thread::sleep(boost::posix_time::seconds(kRunSeconds));
+    running = false;
+    uint64_t total = round_trip_num;
+    client_list.join_all();
+
+    printf("%d clients  %10.0f round trips/s\n", kClientNum, double(total) / kRunSeconds);
+
+    thread.Stop();
+    thread.Join();
+
+    return 0;
+}
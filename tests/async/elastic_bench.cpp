@@ -0,0 +1,82 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// A burst of blocking tasks on a fixed pool and on an elastic pool,
+// then the elastic pool retiring its idle workers.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kBurstTasks = 400;
+
+std::atomic<int> done_num(0);
+
+void Block() {
+    // Stands for a blocking call, it leaves the cpu to other workers.
+    boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+    done_num++;
+}
+
+void PrintStats(const char* name, const async::Thread& thread) {
+    async::Thread::ScaleStats stats = thread.scale_stats();
+    printf("%-22s threads %2d  peak %2d  grow %3llu  retire %3llu  max reached %3llu\n", 
+           name, stats.thread_num, stats.peak_thread_num, 
+           (unsigned long long)stats.grow_num, (unsigned long long)stats.retire_num, 
+           (unsigned long long)stats.max_reached_num);
+}
+
+void Run(const char* name, const async::Thread::Options& options) {
+    async::Thread thread(options);
+
+    done_num = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < kBurstTasks; i++) {
+        thread.PostTask(&Block);
+    }
+    while (done_num < kBurstTasks) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+
+    printf("%-22s burst of %d done in %8.1fms\n", name, kBurstTasks, elapsed.count());
+    PrintStats("  after burst", thread);
+
+    boost::this_thread::sleep(options.idle_timeout * 3);
+    PrintStats("  after idle", thread);
+
+    thread.Stop();
+    thread.Join();
+}
+
+int main() {
+    async::Thread::Options options;
+    options.thread_num = 2;
+    options.idle_timeout = boost::posix_time::milliseconds(100);
+    Run("fixed 2", options);
+
+    options.max_thread_num = 16;
+    options.scale_wait = boost::posix_time::milliseconds(5);
+    Run("elastic 2..16", options);
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+int Square(int a) {
+    return a * a;
+}
+
+int Sum(const std::vector<int>& value_list) {
+    int sum = 0;
+    for (size_t i = 0; i < value_list.size(); i++) {
+        sum += value_list[i];
+    }
+
+    return sum;
+}
+
+void PrintSum(int sum) {
+    std::cout << "sum:" << sum << std::endl;
+}
+
+int main() {
+    // Init threads
+    std::shared_ptr<async::Thread> work_thread(new async::Thread(4));
+    std::shared_ptr<async::Thread> main_thread(new async::Thread());
+
+    // Fan out squares to the work thread
+    std::vector<async::Future<int>> future_list;
+    for (int i = 1; i <= 10; i++) {
+        future_list.push_back(work_thread->PostTaskWithResult(boost::bind(&Square, i)));
+    }
+
+    // Fan in, sum inline on the completing thread, print on the main thread
+    async::Future<void> done = async::WhenAll(future_list)
+        .Then(&Sum)
+        .Then(main_thread, &PrintSum);
+
+    // Index of the first ready square
+    std::cout << "any:" << async::WhenAny(future_list).Get() << std::endl;
+
+    // Waiting for the result
+    done.Get();
+    std::cout << "square(10):" << future_list[9].Get() << std::endl;
+
+    // A task destroyed by a stopped pool breaks its promise,
+    // the continuation passes the error on
+    std::shared_ptr<async::Thread> stopped_thread(new async::Thread());
+    stopped_thread->Stop();
+    stopped_thread->Join();
+    async::Future<int> lost = stopped_thread->PostTaskWithResult(boost::bind(&Square, 3))
+        .Then(&Square);
+    stopped_thread.reset();
+    try {
+        lost.Get();
+    } catch (const async::BrokenPromise& e) {
+        std::cout << "broken:" << e.what() << std::endl;
+    }
+
+    work_thread->Stop();
+    main_thread->Stop();
+    work_thread->Join();
+    main_thread->Join();
+
+    return 0;
+}
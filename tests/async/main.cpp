@@ -48,6 +48,22 @@ int main() {
     // Create a 2 millisecond single timer task
     timer.CreateOnceTimerTask(boost::bind(print_once, 1, 2), boost::posix_time::millisec(2), main_thread);
 
+    // Create a 1 second timer task and cancel it, it never prints
+    int timer_id = timer.CreateTimerTask(boost::bind(print, 0, 0), boost::posix_time::seconds(1), main_thread);
+    timer.CancelTimerTask(timer_id);
+
+    // Post a task that runs on the main thread after 1 second
+    main_thread->PostDelayedTask(boost::bind(print_once, 2, 3), boost::posix_time::seconds(1));
+
+    // Post a task that runs on the main thread every 3 seconds
+    main_thread->PostRepeatingTask(boost::bind(print, 3, 4), boost::posix_time::seconds(3));
+
+    // A worker pinned to cpu 0 runs the once tasks
+    async::Thread::Options options;
+    options.placement.cpu_list.push_back(0);
+    std::shared_ptr<async::Thread> pinned_thread(new async::Thread(options));
+    timer.CreateOnceTimerTask(boost::bind(print_once, 4, 5), boost::posix_time::millisec(5), pinned_thread);
+
     // Create a 6 second timer task
     timer1.CreateTimerTask(boost::bind(print1, 1, 2), boost::posix_time::seconds(6), main_thread);
 
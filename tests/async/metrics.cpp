@@ -0,0 +1,57 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+void Work(int micros) {
+    boost::this_thread::sleep(boost::posix_time::microseconds(micros));
+}
+
+int main() {
+    async::Thread::Options options;
+    options.thread_num = 2;
+    options.enable_metrics = true;
+    async::Thread thread(options);
+
+    for (int i = 0; i < 200; i++) {
+        thread.PostTask(boost::bind(&Work, i % 10 * 100));
+    }
+    std::cout << "queue depth:" << thread.metrics().queue_depth << std::endl;
+
+    boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+    async::Thread::Metrics metrics = thread.metrics();
+    std::cout << "tasks:" << metrics.task_num << std::endl;
+    std::cout << "idle:" << metrics.idle_time << "us" << std::endl;
+    std::cout << "wait p50:" << async::Thread::Metrics::Percentile(metrics.wait_histogram, 0.5) 
+              << "us p99:" << async::Thread::Metrics::Percentile(metrics.wait_histogram, 0.99) 
+              << "us" << std::endl;
+    std::cout << "run p50:" << async::Thread::Metrics::Percentile(metrics.run_histogram, 0.5) 
+              << "us p99:" << async::Thread::Metrics::Percentile(metrics.run_histogram, 0.99) 
+              << "us" << std::endl;
+    for (size_t i = 0; i < metrics.worker_list.size(); i++) {
+        std::cout << "worker " << i << " tasks:" << metrics.worker_list[i].task_num << std::endl;
+    }
+
+    thread.Stop();
+    thread.Join();
+
+    return 0;
+}
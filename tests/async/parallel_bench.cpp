@@ -0,0 +1,104 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <async/async.h>
+
+// Scaling of ParallelFor and ParallelReduce from 1 to N worker threads,
+// the calling thread takes part as well.
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t kItemNum = 1 << 24;
+const size_t kGrain = 4096;
+
+std::vector<double> item_list(kItemNum);
+
+struct Fill {
+    void operator()(size_t begin, size_t end) const {
+        for (size_t i = begin; i < end; i++) {
+            item_list[i] = std::sqrt(double(i));
+        }
+    }
+};
+
+struct Sum {
+    double operator()(size_t begin, size_t end) const {
+        double sum = 0;
+        for (size_t i = begin; i < end; i++) {
+            sum += std::sin(item_list[i]);
+        }
+        return sum;
+    }
+};
+
+double Add(double a, double b) {
+    return a + b;
+}
+
+double Seconds(Clock::time_point begin) {
+    std::chrono::duration<double> cost = Clock::now() - begin;
+    return cost.count();
+}
+
+int main() {
+    int max_thread_num = boost::thread::hardware_concurrency();
+    if (max_thread_num < 8) {
+        max_thread_num = 8;
+    }
+
+    Clock::time_point begin = Clock::now();
+    Fill()(0, kItemNum);
+    double serial_for = Seconds(begin);
+
+    begin = Clock::now();
+    double serial_sum = Sum()(0, kItemNum);
+    double serial_reduce = Seconds(begin);
+
+    printf("%-8s %12s %10s %12s %10s\n", "threads", "for(s)", "speedup", "reduce(s)", "speedup");
+    printf("%-8s %12.4f %10.2f %12.4f %10.2f\n", "serial", serial_for, 1.0, serial_reduce, 1.0);
+
+    for (int thread_num = 1; thread_num <= max_thread_num; thread_num *= 2) {
+        async::Thread thread(thread_num);
+
+        begin = Clock::now();
+        async::ParallelFor(thread, 0, kItemNum, kGrain, Fill());
+        double parallel_for = Seconds(begin);
+
+        begin = Clock::now();
+        double sum = async::ParallelReduce(thread, 0, kItemNum, kGrain, 0.0, Sum(), &Add);
+        double parallel_reduce = Seconds(begin);
+
+        if (std::fabs(sum - serial_sum) > 1e-6 * std::fabs(serial_sum)) {
+            printf("reduce mismatch %f != %f\n", sum, serial_sum);
+            return -1;
+        }
+
+        printf("%-8d %12.4f %10.2f %12.4f %10.2f\n", thread_num,
+               parallel_for, serial_for / parallel_for,
+               parallel_reduce, serial_reduce / parallel_reduce);
+
+        thread.Stop();
+        thread.Join();
+    }
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Post to start latency of interactive tasks while batch tasks 
+// keep the pool busy, with and without priority lanes.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kFloodChains = 64;
+const int kProbeNum = 2000;
+
+std::atomic<bool> flooding(false);
+
+void Flood(async::Thread* thread, async::Thread::Priority priority) {
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(20);
+    while (Clock::now() < end) {
+
+    }
+
+    if (flooding) {
+        thread->PostTask(boost::bind(&Flood, thread, priority), priority);
+    }
+}
+
+void Probe(Clock::time_point post_time, std::vector<double>* latency_list) {
+    std::chrono::duration<double, std::micro> latency = Clock::now() - post_time;
+    latency_list->push_back(latency.count());
+}
+
+void Run(const char* name, 
+         async::Thread::Priority flood_priority, 
+         async::Thread::Priority probe_priority) {
+    async::Thread thread(1);
+    std::vector<double> latency_list;
+    latency_list.reserve(kProbeNum);
+
+    flooding = true;
+    for (int i = 0; i < kFloodChains; i++) {
+        thread.PostTask(boost::bind(&Flood, &thread, flood_priority), flood_priority);
+    }
+
+    for (int i = 0; i < kProbeNum; i++) {
+        thread.PostTask(boost::bind(&Probe, Clock::now(), &latency_list), probe_priority);
+        boost::this_thread::sleep(boost::posix_time::microseconds(500));
+    }
+    flooding = false;
+
+    thread.Stop();
+    thread.Join();
+
+    std::sort(latency_list.begin(), latency_list.end());
+    printf("%-24s probes %6zu  p50 %10.1fus  p99 %10.1fus\n", name, latency_list.size(),
+           latency_list[latency_list.size() / 2],
+           latency_list[latency_list.size() * 99 / 100]);
+}
+
+int main() {
+    Run("fifo (all NORMAL)", async::Thread::NORMAL, async::Thread::NORMAL);
+    Run("HIGH over BACKGROUND", async::Thread::BACKGROUND, async::Thread::HIGH);
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <sys/resource.h>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Thousands of 100ms periodic timers with spread out phases,
+// cpu time and context switches with and without slack.
+
+const int kTimerNum = 5000;
+const int kRunSeconds = 2;
+
+std::atomic<int> fired_num(0);
+
+void Ping() {
+    fired_num++;
+}
+
+double CpuSeconds(const struct rusage& usage) {
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + 
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void Run(const boost::posix_time::time_duration& slack) {
+    std::shared_ptr<async::Thread> thread(new async::Thread(1));
+    fired_num = 0;
+
+    // The timers start 20us apart.
+    std::vector<std::unique_ptr<async::Timer>> timer_list;
+    for (int i = 0; i < kTimerNum; i++) {
+        timer_list.push_back(std::unique_ptr<async::Timer>(new async::Timer()));
+        timer_list.back()->CreateTimerTask(&Ping, boost::posix_time::milliseconds(100), 
+                                           thread, slack);
+        if (i % 50 == 0) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
+    }
+
+    struct rusage start_usage;
+    struct rusage end_usage;
+    getrusage(RUSAGE_SELF, &start_usage);
+    boost::this_thread::sleep(boost::posix_time::seconds(kRunSeconds));
+    getrusage(RUSAGE_SELF, &end_usage);
+
+    printf("slack %5lldms  fired %7d  cpu %6.3fs  context switches %7ld\n", 
+           (long long)slack.total_milliseconds(), fired_num.load(), 
+           CpuSeconds(end_usage) - CpuSeconds(start_usage),
+           (end_usage.ru_nvcsw + end_usage.ru_nivcsw) - 
+           (start_usage.ru_nvcsw + start_usage.ru_nivcsw));
+
+    timer_list.clear();
+    thread->Stop();
+    thread->Join();
+}
+
+int main() {
+    // One shard, the wakeups of a single timer thread are compared.
+    async::Timer::SetShardNum(1);
+
+    Run(boost::posix_time::milliseconds(0));
+    Run(boost::posix_time::milliseconds(16));
+    Run(boost::posix_time::milliseconds(64));
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Post to run latency of tasks posted one at a time to an idle pool,
+// with workers that park at once and with workers that spin first.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kProbeNum = 5000;
+
+void Probe(Clock::time_point post_time, std::vector<double>* latency_list) {
+    std::chrono::duration<double, std::micro> latency = Clock::now() - post_time;
+    latency_list->push_back(latency.count());
+}
+
+void Run(const char* name, const boost::posix_time::time_duration& spin_time) {
+    async::Thread::Options options;
+    options.spin_time = spin_time;
+    async::Thread thread(options);
+    std::vector<double> latency_list;
+    latency_list.reserve(kProbeNum);
+
+    for (int i = 0; i < kProbeNum; i++) {
+        thread.PostTask(boost::bind(&Probe, Clock::now(), &latency_list));
+        // Long enough for the worker to go idle, shorter than the spin.
+        boost::this_thread::sleep(boost::posix_time::microseconds(200));
+    }
+
+    thread.Stop();
+    thread.Join();
+
+    std::sort(latency_list.begin(), latency_list.end());
+    printf("%-18s probes %6zu  p50 %8.1fus  p99 %8.1fus\n", name, latency_list.size(),
+           latency_list[latency_list.size() / 2],
+           latency_list[latency_list.size() * 99 / 100]);
+}
+
+int main() {
+    Run("park", boost::posix_time::time_duration());
+    Run("spin 1ms", boost::posix_time::milliseconds(1));
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <memory>
+#include <cstdlib>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Allocations made by the posting thread for every posted task.
+// The pool is kept busy while posting, so no wake up is posted.
+
+thread_local size_t alloc_num = 0;
+
+void* operator new(size_t size) {
+    alloc_num++;
+    void* ptr = malloc(size);
+    if (ptr == NULL) {
+        throw std::bad_alloc();
+    }
+
+    return ptr;
+}
+void operator delete(void* ptr) noexcept {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpragmas"
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+    free(ptr);
+#pragma GCC diagnostic pop
+}
+
+const int kPostNum = 100000;
+
+class Request {
+public:
+    void Handle(const std::shared_ptr<int>& data) {}
+};
+
+void Block(boost::mutex* mutex) {
+    mutex->lock();
+    mutex->unlock();
+}
+
+double CountIoService(const std::shared_ptr<int>& data) {
+    boost::asio::io_service io_service;
+    Request request;
+
+    size_t begin = alloc_num;
+    for (int i = 0; i < kPostNum; i++) {
+        boost::function<void(void)> task = boost::bind(&Request::Handle, &request, data);
+        io_service.post(task);
+    }
+    double result = double(alloc_num - begin) / kPostNum;
+
+    io_service.run();
+
+    return result;
+}
+
+template <typename F>
+double CountThread(const std::shared_ptr<int>& data, F make_task) {
+    async::Thread thread;
+    Request request;
+
+    boost::mutex mutex;
+    mutex.lock();
+    thread.PostTask(boost::bind(&Block, &mutex));
+    // Warm up the queue buffer.
+    for (int i = 0; i < kPostNum; i++) {
+        thread.PostTask(make_task(&request, data));
+    }
+    boost::this_thread::sleep(boost::posix_time::millisec(10));
+
+    size_t begin = alloc_num;
+    for (int i = 0; i < kPostNum; i++) {
+        thread.PostTask(make_task(&request, data));
+    }
+    double result = double(alloc_num - begin) / kPostNum;
+
+    mutex.unlock();
+    thread.Stop();
+    thread.Join();
+
+    return result;
+}
+
+boost::function<void(void)> MakeFunction(Request* request, const std::shared_ptr<int>& data) {
+    return boost::bind(&Request::Handle, request, data);
+}
+
+async::Task MakeTask(Request* request, const std::shared_ptr<int>& data) {
+    return boost::bind(&Request::Handle, request, data);
+}
+
+int main() {
+    std::shared_ptr<int> data(new int(0));
+
+    std::cout << "allocations per post" << std::endl;
+    std::cout << "io_service::post boost::function: " << CountIoService(data) << std::endl;
+    std::cout << "PostTask boost::function:         " << CountThread(data, &MakeFunction) << std::endl;
+    std::cout << "PostTask boost::bind:             " << CountThread(data, &MakeTask) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Tasks per second of the thread pool.
+// Every chain keeps posting its next task from the worker thread,
+// compares a plain io_service pool with both Thread modes.
+
+const int kTotalTasks = 1 << 20;
+const int kChainsPerThread = 4;
+
+std::atomic<int> done_num(0);
+boost::function<void(const boost::function<void(void)>&)> post;
+
+void ChainTask(int remain) {
+    done_num++;
+    if (remain > 0) {
+        post(boost::bind(&ChainTask, remain - 1));
+    }
+}
+
+double Run(int thread_num) {
+    done_num = 0;
+    int chain_num = thread_num * kChainsPerThread;
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < chain_num; i++) {
+        post(boost::bind(&ChainTask, kTotalTasks / chain_num - 1));
+    }
+    while (done_num < kTotalTasks / chain_num * chain_num) {
+        boost::this_thread::sleep(boost::posix_time::microseconds(100));
+    }
+    std::chrono::duration<double> cost = std::chrono::steady_clock::now() - begin;
+
+    return done_num / cost.count();
+}
+
+double RunIoService(int thread_num) {
+    boost::asio::io_service io_service;
+    boost::asio::io_service::work* work = new boost::asio::io_service::work(io_service);
+    boost::thread_group threads;
+    for (int i = 0; i < thread_num; i++) {
+        threads.create_thread(boost::bind(&boost::asio::io_service::run, &io_service));
+    }
+
+    post = [&io_service](const boost::function<void(void)>& task) { io_service.post(task); };
+    double result = Run(thread_num);
+
+    delete work;
+    io_service.stop();
+    threads.join_all();
+
+    return result;
+}
+
+double RunThread(int thread_num, async::Thread::Mode mode) {
+    async::Thread thread(thread_num, mode);
+
+    post = [&thread](const boost::function<void(void)>& task) { thread.PostTask(task); };
+    double result = Run(thread_num);
+
+    thread.Stop();
+    thread.Join();
+
+    return result;
+}
+
+int main() {
+    printf("%-8s %16s %16s %16s\n", "threads", "io_service", "SHARED", "WORK_STEALING");
+    for (int thread_num = 1; thread_num <= 64; thread_num *= 2) {
+        printf("%-8d %16.0f %16.0f %16.0f\n", thread_num,
+               RunIoService(thread_num),
+               RunThread(thread_num, async::Thread::SHARED),
+               RunThread(thread_num, async::Thread::WORK_STEALING));
+    }
+
+    return 0;
+}
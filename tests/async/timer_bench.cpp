@@ -0,0 +1,103 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <async/async.h>
+#include <boost/bind.hpp>
+
+// Timer create, cancel and fire throughput from several threads 
+// against the number of timer shards.
+// The shard number is fixed per process, without an argument 
+// the benchmark runs itself once for each shard number.
+
+typedef std::chrono::steady_clock Clock;
+
+const int kCallerNum = 8;
+const int kChurnNum = 50000;
+const int kFireNum = 20000;
+
+std::atomic<int> fired_num(0);
+
+void Fire() {
+    fired_num++;
+}
+
+void Churn(const std::shared_ptr<async::Thread>& thread) {
+    async::Timer timer;
+    for (int i = 0; i < kChurnNum; i++) {
+        int timer_id = timer.CreateTimerTask(&Fire, boost::posix_time::seconds(10), thread);
+        timer.CancelTimerTask(timer_id);
+    }
+}
+
+void Schedule(const std::shared_ptr<async::Thread>& thread) {
+    async::Timer timer;
+    for (int i = 0; i < kFireNum; i++) {
+        timer.CreateOnceTimerTask(&Fire, boost::posix_time::milliseconds(1 + i % 20), thread);
+    }
+}
+
+double RunCallers(const boost::function<void()>& function) {
+    Clock::time_point start = Clock::now();
+    boost::thread_group caller_list;
+    for (int i = 0; i < kCallerNum; i++) {
+        caller_list.create_thread(function);
+    }
+    caller_list.join_all();
+
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("%-8s %16s %16s\n", "shards", "create+cancel/s", "fired/s");
+        fflush(stdout);
+        for (int shard_num = 1; shard_num <= 8; shard_num *= 2) {
+            std::string command = std::string(argv[0]) + " " + std::to_string(shard_num);
+            if (std::system(command.c_str()) != 0) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    int shard_num = std::atoi(argv[1]);
+    async::Timer::SetShardNum(shard_num);
+
+    std::shared_ptr<async::Thread> thread(new async::Thread(2));
+    double churn_time = RunCallers(boost::bind(&Churn, thread));
+
+    Clock::time_point start = Clock::now();
+    RunCallers(boost::bind(&Schedule, thread));
+    while (fired_num < kCallerNum * kFireNum) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    double fire_time = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("%-8d %16.0f %16.0f\n", shard_num, 
+           kCallerNum * kChurnNum / churn_time, kCallerNum * kFireNum / fire_time);
+
+    thread->Stop();
+    thread->Join();
+
+    return 0;
+}
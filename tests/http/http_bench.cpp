@@ -0,0 +1,141 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <http/http.h>
+#include "test_server.h"
+
+// Request throughput of the HttpManager against a local stand-in server
+// that answers every request with a small keep-alive response.
+// Usage: http_bench [loop_num] [host_num] [sharing] [in_flight] [http_version] [url]
+// host_num servers on different ports stand for different hosts,
+// sharing 0 turns off the DNS and TLS session share, http_version is
+// an HttpLoop::HttpVersion. With a url every request goes to it instead,
+// the local server only speaks http/1.1.
+
+const int kRequestNum = 20000;
+// Requests kept running, set from the command line.
+int in_flight = 256;
+
+// Keeps in_flight requests running until kRequestNum are done.
+class Client : public http::HttpRequest::Delegate {
+public:
+    Client(const std::vector<std::string>& url_list) 
+        : url_list_(url_list)
+        , started_num_(0)
+        , done_num_(0)
+        , failed_num_(0) {}
+
+    void Start() {
+        for (int i = 0; i < in_flight; i++) {
+            Next();
+        }
+    }
+
+    void OnHttpRequestComplete(std::shared_ptr<http::HttpRequest> request) override {
+        // Every response of the servers has a body.
+        if (request->status() != http::HttpRequest::SUCCESS || request->response().empty()) {
+            failed_num_++;
+        }
+        done_num_++;
+        Next();
+    }
+
+    bool done() const { return done_num_ >= kRequestNum; }
+    int failed_num() const { return failed_num_; }
+
+private:
+    void Next() {
+        int index = started_num_++;
+        if (index >= kRequestNum) {
+            return;
+        }
+        std::shared_ptr<http::HttpRequest> request(new http::HttpRequest(
+            http::HttpRequest::GET, url_list_[index % url_list_.size()], this));
+        http::HttpManager::GetInstance()->AddHttpRequest(request);
+    }
+
+    std::vector<std::string> url_list_;
+    std::atomic<int> started_num_;
+    std::atomic<int> done_num_;
+    std::atomic<int> failed_num_;
+};
+
+int main(int argc, char* argv[]) {
+    int loop_num = argc > 1 ? atoi(argv[1]) : 1;
+    int host_num = argc > 2 ? atoi(argv[2]) : 4;
+    bool sharing = argc > 3 ? atoi(argv[3]) != 0 : true;
+    in_flight = argc > 4 ? atoi(argv[4]) : in_flight;
+    int http_version = argc > 5 ? atoi(argv[5]) : http::HttpLoop::HTTP1_1;
+
+    async::Thread server(2);
+    std::vector<std::unique_ptr<TestServer>> server_list;
+    std::vector<std::string> url_list;
+    if (argc > 6) {
+        host_num = 0;
+        url_list.push_back(argv[6]);
+    }
+    for (int i = 0; i < host_num; i++) {
+        server_list.push_back(std::unique_ptr<TestServer>(new TestServer(&server, 2, 0)));
+        url_list.push_back(server_list.back()->url());
+    }
+
+    http::HttpManager::GetInstance()->set_loop_num(loop_num);
+    http::HttpManager::GetInstance()->set_distribution(http::HttpManager::HOST_HASH);
+    http::HttpManager::GetInstance()->set_connection_sharing(sharing);
+    http::HttpManager::GetInstance()->set_http_version((http::HttpLoop::HttpVersion)http_version);
+    http::HttpManager::GetInstance()->Start();
+
+    Client client(url_list);
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    client.Start();
+    uint64_t peak_connection_num = 0;
+    uint64_t peak_stream_num = 0;
+    while (!client.done()) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        http::HttpLoop::ConnectionStats stats = http::HttpManager::GetInstance()->connection_stats();
+        peak_connection_num = std::max(peak_connection_num, stats.connection_in_use_num);
+        peak_stream_num = std::max(peak_stream_num, stats.stream_in_use_num);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    printf("%d loops  %d hosts  %d requests  %d failed  %10.0f requests/s\n", 
+           loop_num, host_num, kRequestNum, client.failed_num(), kRequestNum / elapsed.count());
+
+    http::HttpLoop::ConnectionStats stats = http::HttpManager::GetInstance()->connection_stats();
+    double request_num = std::max<uint64_t>(stats.request_num, 1);
+    printf("sharing %s  connections %llu  recycled handles %llu  per request: "
+           "dns %.2fus  connect %.2fus  tls %.2fus\n", sharing ? "on" : "off",
+           (unsigned long long)stats.connection_num, 
+           (unsigned long long)stats.recycled_handle_num,
+           stats.name_lookup_time / request_num, stats.connect_time / request_num,
+           stats.tls_time / request_num);
+    printf("http/2 requests %llu  peak in use: connections %llu  streams %llu\n",
+           (unsigned long long)stats.http2_request_num, 
+           (unsigned long long)peak_connection_num, (unsigned long long)peak_stream_num);
+
+    http::HttpManager::GetInstance()->Stop();
+    server.Stop();
+    server.Join();
+
+    return 0;
+}
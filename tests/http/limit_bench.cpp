@@ -0,0 +1,111 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <http/http.h>
+#include "test_server.h"
+
+// A burst to a slow host followed by a few requests to a fast host.
+// Usage: limit_bench [max_host_requests] [max_requests]
+// Without limits the burst opens a connection per request,
+// with them it waits in the slow host's queue and the fast host 
+// takes its turns.
+
+const int kSlowRequestNum = 2000;
+const int kFastRequestNum = 100;
+const int kSlowDelayMs = 50;
+
+typedef std::chrono::steady_clock Clock;
+
+// Times the requests of one host.
+class Client : public http::HttpRequest::Delegate {
+public:
+    Client() : done_num_(0), latency_(0) {}
+
+    void Add(const std::string& url, int request_num) {
+        for (int i = 0; i < request_num; i++) {
+            std::shared_ptr<http::HttpRequest> request(new http::HttpRequest(
+                http::HttpRequest::GET, url, this));
+            request->add_params("start", std::to_string(Clock::now().time_since_epoch().count()));
+            http::HttpManager::GetInstance()->AddHttpRequest(request);
+        }
+    }
+
+    void OnHttpRequestComplete(std::shared_ptr<http::HttpRequest> request) override {
+        Clock::rep start = std::stoll(request->params().at("start"));
+        latency_ += (Clock::now().time_since_epoch().count() - start) / 1000;
+        done_num_++;
+    }
+
+    std::atomic<int> done_num_;
+    std::atomic<int64_t> latency_;
+};
+
+int main(int argc, char* argv[]) {
+    int max_host_requests = argc > 1 ? atoi(argv[1]) : 0;
+    int max_requests = argc > 2 ? atoi(argv[2]) : 0;
+
+    async::Thread server(1);
+    TestServer slow_server(&server, 2, kSlowDelayMs);
+    TestServer fast_server(&server, 2, 0);
+
+    http::HttpManager::GetInstance()->set_max_host_requests(max_host_requests);
+    http::HttpManager::GetInstance()->set_max_requests(max_requests);
+    http::HttpManager::GetInstance()->Start();
+
+    Client slow_client;
+    Client fast_client;
+    slow_client.Add(slow_server.url(), kSlowRequestNum);
+    fast_client.Add(fast_server.url(), kFastRequestNum);
+
+    uint64_t peak_connection_num = 0;
+    while (fast_client.done_num_ < kFastRequestNum) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        http::HttpLoop::ConnectionStats stats = http::HttpManager::GetInstance()->connection_stats();
+        peak_connection_num = std::max(peak_connection_num, stats.connection_in_use_num);
+    }
+
+    printf("max host requests %d  max requests %d  fast host latency %.1fms  "
+           "slow done %d  peak connections %llu\n", 
+           max_host_requests, max_requests, 
+           fast_client.latency_ / 1000.0 / kFastRequestNum, 
+           slow_client.done_num_.load(), (unsigned long long)peak_connection_num);
+
+    http::HttpLoop::HOST_STATS_LIST stats_list = http::HttpManager::GetInstance()->host_stats();
+    for (auto iter = stats_list.begin(); iter != stats_list.end(); iter++) {
+        const char* name = iter->first == slow_server.host() ? "slow" : "fast";
+        printf("  %s host  started %llu  waiting %llu  in flight %llu  "
+               "queue time avg %.1fms max %.1fms\n", name,
+               (unsigned long long)iter->second.request_num, 
+               (unsigned long long)iter->second.waiting_num,
+               (unsigned long long)iter->second.in_flight_num,
+               iter->second.queue_time / 1000.0 / std::max<uint64_t>(iter->second.request_num, 1),
+               iter->second.max_queue_time / 1000.0);
+    }
+
+    // The slow burst is still running, its requests are dropped.
+    http::HttpManager::GetInstance()->Stop();
+    server.Stop();
+    server.Join();
+
+    return 0;
+}
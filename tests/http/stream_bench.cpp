@@ -0,0 +1,104 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sys/resource.h>
+#include <http/http.h>
+#include <boost/bind.hpp>
+#include "test_server.h"
+
+// Peak memory of a large download delivered whole and streamed.
+// Usage: stream_bench [whole|stream]
+// The stream delegate pauses every kPauseSize bytes and is resumed
+// from another thread, like a consumer that falls behind.
+
+const size_t kBodySize = 256 * 1024 * 1024;
+const size_t kPauseSize = 16 * 1024 * 1024;
+
+class Client : public http::HttpRequest::StreamDelegate {
+public:
+    Client() : received_(0), paused_num_(0), done_(false) {}
+
+    bool OnHttpRequestData(std::shared_ptr<http::HttpRequest> request,
+                           const char* data,
+                           size_t size) override {
+        // Take the chunk after a pause, it is delivered again.
+        if (received_ / kPauseSize != (received_ + size) / kPauseSize && 
+            paused_num_ < (received_ + size) / kPauseSize) {
+            paused_num_++;
+            resumer_.PostDelayedTask(boost::bind(&Client::Resume, request), 
+                                     boost::posix_time::milliseconds(1));
+            return false;
+        }
+        received_ += size;
+        return true;
+    }
+
+    void OnHttpRequestComplete(std::shared_ptr<http::HttpRequest> request) override {
+        received_ += request->response().size();
+        done_ = true;
+    }
+
+    static void Resume(std::shared_ptr<http::HttpRequest> request) {
+        http::HttpManager::GetInstance()->ResumeHttpRequest(request);
+    }
+
+    async::Thread resumer_;
+    std::atomic<size_t> received_;
+    size_t paused_num_;
+    std::atomic<bool> done_;
+};
+
+int main(int argc, char* argv[]) {
+    bool stream = argc > 1 && strcmp(argv[1], "stream") == 0;
+
+    async::Thread server(1);
+    TestServer test_server(&server, kBodySize, 0);
+    std::string url = test_server.url();
+
+    http::HttpManager::GetInstance()->Start();
+
+    Client client;
+    std::shared_ptr<http::HttpRequest> request(new http::HttpRequest(
+        http::HttpRequest::GET, url, &client));
+    if (stream) {
+        request->set_stream_delegate(&client);
+    }
+
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    http::HttpManager::GetInstance()->AddHttpRequest(request);
+    while (!client.done_) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-6s received %zu MB  pauses %zu  %8.1fms  peak rss %ld MB\n", 
+           stream ? "stream" : "whole", client.received_ / (1024 * 1024), client.paused_num_,
+           elapsed.count(), usage.ru_maxrss / 1024);
+
+    http::HttpManager::GetInstance()->Stop();
+    server.Stop();
+    server.Join();
+
+    return 0;
+}
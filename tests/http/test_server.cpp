@@ -0,0 +1,134 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#include "test_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <boost/bind.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+namespace {
+
+const size_t kChunkSize = 64 * 1024;
+
+const std::string& Chunk() {
+    static const std::string chunk(kChunkSize, 'x');
+    return chunk;
+}
+
+class Session : public boost::enable_shared_from_this<Session> {
+public:
+    Session(boost::asio::io_service& io_service, size_t body_size, int delay_ms) 
+        : socket_(io_service)
+        , timer_(io_service)
+        , body_size_(body_size)
+        , delay_ms_(delay_ms)
+        , sent_(0) {}
+
+    void Read() {
+        boost::asio::async_read_until(socket_, buffer_, "\r\n\r\n", 
+            boost::bind(&Session::OnRead, shared_from_this(), _1, _2));
+    }
+
+    void OnRead(const boost::system::error_code& err, size_t size) {
+        if (err) {
+            return;
+        }
+        buffer_.consume(size);
+        if (delay_ms_ > 0) {
+            timer_.expires_from_now(std::chrono::milliseconds(delay_ms_));
+            timer_.async_wait(boost::bind(&Session::WriteHeader, shared_from_this(), _1));
+        } else {
+            WriteHeader(boost::system::error_code());
+        }
+    }
+
+    void WriteHeader(const boost::system::error_code& err) {
+        header_ = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_size_) + "\r\n\r\n";
+        sent_ = 0;
+        boost::asio::async_write(socket_, boost::asio::buffer(header_), 
+                                 boost::bind(&Session::OnWrite, shared_from_this(), _1));
+    }
+
+    void OnWrite(const boost::system::error_code& err) {
+        if (err) {
+            return;
+        }
+        if (sent_ >= body_size_) {
+            Read();
+            return;
+        }
+        size_t size = std::min(kChunkSize, body_size_ - sent_);
+        sent_ += size;
+        boost::asio::async_write(socket_, boost::asio::buffer(Chunk().data(), size), 
+                                 boost::bind(&Session::OnWrite, shared_from_this(), _1));
+    }
+
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::steady_timer timer_;
+    boost::asio::streambuf buffer_;
+    std::string header_;
+    size_t body_size_;
+    int delay_ms_;
+    size_t sent_;
+};
+
+void OnAccept(boost::shared_ptr<Session> session, const boost::system::error_code& err) {
+    if (!err) {
+        session->socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+        session->Read();
+    }
+}
+
+} // namespace
+
+TestServer::TestServer(async::Thread* thread, size_t body_size, int delay_ms)
+    : thread_(thread)
+    , body_size_(body_size)
+    , delay_ms_(delay_ms)
+    , acceptor_(new boost::asio::ip::tcp::acceptor(thread->io_service(), 
+          boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))) {
+    host_ = "127.0.0.1:" + std::to_string(acceptor_->local_endpoint().port());
+    Accept();
+}
+TestServer::~TestServer() {
+    boost::system::error_code err;
+    acceptor_->close(err);
+}
+
+const std::string& TestServer::host() const {
+    return host_;
+}
+
+std::string TestServer::url() const {
+    return "http://" + host_ + "/";
+}
+
+void TestServer::Accept() {
+    boost::shared_ptr<Session> session(new Session(thread_->io_service(), body_size_, delay_ms_));
+    acceptor_->async_accept(session->socket_, [this, session](const boost::system::error_code& err) {
+        OnAccept(session, err);
+        if (err != boost::asio::error::operation_aborted) {
+            Accept();
+        }
+    });
+
+    return;
+}
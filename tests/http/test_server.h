@@ -0,0 +1,51 @@
+/*
+ *
+ * Copyright 2018 Guolian Zhang.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <async/async.h>
+
+// Local stand-in http/1.1 server for the http benches.
+// Answers every request on a keep-alive connection with a 200 and 
+// body_size bytes of body, delay_ms after the request arrived.
+// Runs on the io_service of thread, stop the thread before the server
+// is destroyed.
+class TestServer {
+public:
+    TestServer(async::Thread* thread, size_t body_size, int delay_ms);
+    ~TestServer();
+
+    // "127.0.0.1:port"
+    const std::string& host() const;
+    // "http://127.0.0.1:port/"
+    std::string url() const;
+
+private:
+    TestServer(const TestServer&) = delete;
+    TestServer& operator=(const TestServer&) = delete;
+
+    void Accept();
+
+    async::Thread* thread_;
+    size_t body_size_;
+    int delay_ms_;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
+    std::string host_;
+};